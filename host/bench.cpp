@@ -0,0 +1,400 @@
+/*
+ * bench.cpp
+ *
+ * Host benchmark of the PLC library: one fixture per component type (and per function of
+ * Logic2, Calc2 and CompareNumeric), a thermistor conversion by Linearize and in floating point,
+ * the timer interrupt with a varying number of timers, whole scans of 8 ... MAXCOMPONENTS components and
+ * the conveyor lanes of lanes.h as a FunctionBlock and unrolled and the step ring of steps.h as a
+ * Sequencer and as a Bistable ladder, and forking (a snapshot and a restore) of the largest scan
+ * ladder and of the lanes. The snapshot sizes and fork rates are printed after the results.
+ *
+ *   bench                       print the results as "benchmark,ns" lines
+ *   bench --write FILE          write the results to FILE as the baseline
+ *   bench --compare FILE [TOL]  compare with the baseline in FILE and fail (exit 1) if any
+ *                               benchmark got slower than baseline * (1 + TOL), default TOL 0.3
+ *
+ * Each line is "benchmark,ns,relative": the best nanoseconds per call on the host and the
+ * cost relative to a fixed reference workload timed in turns with it, both the median of RUNS
+ * runs of the whole suite. Only the relative cost
+ * is compared, so that a machine running faster or slower as a whole (clock scaling, other
+ * load) is not taken for a regression. Still, a baseline is only meaningful for the same machine
+ * and compiler: the point is to catch a change that makes something relatively slower, not to
+ * predict the AVR timing. Use CList.profile() on the target for that.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+#include "lanes.h"
+#include "steps.h"
+
+#define ROUNDS 100000
+#define REPEATS 15
+#define RUNS 5
+#define TOLERANCE 0.3
+
+typedef void (Component::*Method)();
+
+// Reaches the protected Component::execute() of any component, virtual call included
+struct Exec: public Component {
+	static Method method() { return &Exec::execute; }
+};
+
+struct Result {
+	std::string name;
+	double ns;			// nanoseconds per call
+	double rel;			// cost relative to the reference workload
+};
+static std::vector<Result> results;
+
+// Fixed workload of roughly the size of a component call, timed together with every benchmark
+static volatile uint16_t referenceData[16];
+
+static void referenceBody() {
+uint8_t cnt;
+uint16_t sum = 0;
+	for ( cnt = 0; cnt < 16; cnt++ ) sum += referenceData[cnt];
+	referenceData[sum & 15] = sum;
+}
+
+template<typename F> static double runOnce( uint32_t rounds, F body ) {
+uint32_t rnd;
+std::chrono::steady_clock::time_point start;
+	start = std::chrono::steady_clock::now();
+	for ( rnd = 0; rnd < rounds; rnd++ ) body();
+	return std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - start ).count() / rounds;
+}
+
+// Time 'rounds' calls of body() in REPEATS runs, each run alternating with a run of the
+// reference, and record the best nanoseconds per call and its ratio to the best reference time
+template<typename F> static void timeIt( const std::string &name, uint32_t rounds, F body ) {
+uint32_t rep;
+double ns, ref, bestNs = 1e30, bestRef = 1e30;
+	for ( rep = 0; rep < REPEATS; rep++ ) {
+		ref = runOnce( ROUNDS, referenceBody );
+		ns = runOnce( rounds, body );
+		if ( ns < bestNs ) bestNs = ns;
+		if ( ref < bestRef ) bestRef = ref;
+	}
+	results.push_back( Result{ name, bestNs, bestNs / bestRef } );
+}
+
+// Power on and an empty ladder
+static void fresh() {
+	hostReset();
+	CList.begin();
+}
+
+// Time a single component. 'stimulus' runs before every call to move the inputs around
+template<typename F> static void block( const std::string &name, Component *c, F stimulus ) {
+Method exec = Exec::method();
+	timeIt( name, ROUNDS, [&]{ stimulus(); (c->*exec)(); } );
+}
+
+static void block( const std::string &name, Component *c ) {
+	block( name, c, []{} );
+}
+
+static void toggle32() { bits[4] ^= 0x01; }
+
+static const uint16_t curve[] PROGMEM = { 0, 4000,  1000, 3000,  2000, 2500,  4000, 2000,
+	8000, 1600,  16000, 1300,  32000, 1100,  65535, 1000 };
+
+// 10k NTC (B 3950) under a 10k resistor, 10 bit ADC to 0.1 degC + 50 degC: the table made by
+// 'lintable ntc 16' (see lintable.cpp) and the same conversion in floating point
+static const uint16_t ntc[] PROGMEM = { 20, 2001,  26, 1882,  34, 1767,  44, 1662,  58, 1553,  77, 1446,
+	106, 1330,  144, 1221,  200, 1106,  281, 986,  402, 851,  787, 502,  890, 376,  948, 271,  981, 177,  1000, 89 };
+
+class FloatNtc: public Component {
+public:
+	FloatNtc(numeric inPut, numeric outPut):Component(inPut, outPut) {};
+private:
+	void execute() {
+	float r;
+		r = 10000.0f * ints[inBit] / ( 1023 - ints[inBit] );
+		ints[outBit] = ( 1 / ( 1 / 298.15f + logf( r / 10000 ) / 3950 ) - 273.15f + 50 ) * 10;
+	};
+};
+
+// ADC readings over the range of the NTC table
+static void nextAdc() { ints[0] = ints[0] >= 900 ? 20 + ints[0] % 97 : ints[0] + 97; }
+
+static void components() {
+static const char *logicName[] = { "AND", "NAND", "OR", "NOR", "XOR" };
+static const char *calcName[] = { "PLUS", "MINUS", "MUL", "DIV", "MOD" };
+static const char *compareName[] = { "LT", "LE", "EQ", "GE", "GT" };
+uint8_t f;
+FunctionBlock *fb;
+Sequencer *seq;
+static const logicBit fbBits[2][2] = { { 32, 48 }, { 33, 49 } };
+	fresh();
+	block( "Not", new Not( 32, 40 ), toggle32 );
+	for ( f = AND; f <= XOR; f++ ) {
+		fresh();
+		bits[4] = 0x02;
+		block( std::string( "Logic2." ) + logicName[f], new Logic2( 32, 33, 40, (logicFunction)f ), toggle32 );
+	}
+	for ( f = PLUS; f <= MOD; f++ ) {
+		fresh();
+		ints[0] = 1234;
+		ints[1] = 56;
+		block( std::string( "Calc2." ) + calcName[f], new Calc2( 0, 1, 2, (numericFunction)f ) );
+	}
+	fresh();
+	block( "Bistable", new Bistable( 32, 33, 40 ), []{ bits[4] ^= 0x03; } );
+	fresh();
+	block( "Astable", new Astable( 32, 40, 5, 5 ), toggle32 );
+	fresh();
+	block( "Monostable", new Monostable( 32, 40, 100 ), toggle32 );
+	fresh();
+	block( "VMonostable", new VMonostable( 32, 40, 0 ), toggle32 );
+	fresh();
+	block( "DnCounter", new DnCounter( 32, 33, 40, 1000 ), toggle32 );
+	fresh();
+	block( "UpCounter", new UpCounter( 32, 33, 0 ), toggle32 );
+	fresh();
+	block( "Delay", new Delay( 32, 33, 40, 5, 5 ), toggle32 );
+	fresh();
+	ints[0] = 5;
+	ints[1] = 5;
+	block( "VDelay", new VDelay( 32, 33, 40, 0, 1 ), toggle32 );
+	fresh();
+	block( "BitMux2_1", new BitMux2_1( 32, 33, 34, 40 ), []{ bits[4] ^= 0x05; } );
+	fresh();
+	block( "BitMux4_1", new BitMux4_1( 32, 33, 34, 35, 36, 37, 40 ), []{ bits[4] = ( bits[4] + 0x10 ) & 0x3F; } );
+	fresh();
+	block( "IntMux2_1", new IntMux2_1( 0, 1, 32, 2 ), toggle32 );
+	fresh();
+	block( "IntMux4_1", new IntMux4_1( 0, 1, 2, 3, 32, 33, 4 ), []{ bits[4] = ( bits[4] + 1 ) & 0x03; } );
+	fresh();
+	hostAnalog[0] = 512;
+	block( "AnalogIn", new AnalogIn( 0, 0, 0.5, 1.25 ) );
+	for ( f = LT; f <= GT; f++ ) {
+		fresh();
+		ints[1] = 100;
+		block( std::string( "CompareNumeric." ) + compareName[f], new CompareNumeric( 0, 1, 40, (compareOp)f ), []{ ints[0] ^= 0x00C0; } );
+	}
+	fresh();
+	block( "Linearize", new Linearize( 0, 1, curve, 8 ), []{ ints[0] += 977; } );
+	ints[0] = 20;
+	block( "Linearize.ntc16", new Linearize( 0, 1, ntc, 16 ), nextAdc );
+	ints[0] = 20;
+	block( "Linearize.float", new FloatNtc( 0, 1 ), nextAdc );
+	fresh();
+	bits[4] = 0x01;
+	ints[0] = 500;
+	block( "PID", new PID( 32, 0, 1, 2, 2.0, 0.5, 1.0, 0, 0, 1000 ), []{ ints[1] ^= 0x0055; } );
+	fresh();
+	bits[4] = 0x01;
+	block( "PID.wait", new PID( 32, 0, 1, 2, 2.0, 0.5, 1.0, 60000, 0, 1000 ) );	// an evaluation is not due
+	fresh();
+	block( "Ramp", new Ramp( 0, 1, 10, 0, 0, 60000 ), []{ ints[0] ^= 0x8000; } );
+	fresh();
+	block( "PWMOut", new PWMOut( 0, 9, 1000 ), []{ ints[0] ^= 0x0155; } );
+	fresh();
+	seq = new Sequencer( 33, 64, 8, 8, 0 );
+	for ( f = 0; f < 8; f++ ) seq->transition( f, ( f + 1 ) % 8, 32, 0 );
+	bits[4] = 0x01;
+	block( "Sequencer", seq );
+	fresh();
+	fb = new FunctionBlock( 10, 1, 1, 1, 8, 1, 0, 0, 2 );
+	fb->define();
+	new Monostable( 80, 81, 100 );
+	new UpCounter( 80, 255, 8 );
+	fb->endDefine();
+	fb->instance( fbBits[0], NULL );
+	fb->instance( fbBits[1], NULL );
+	block( "FunctionBlock.2x2", fb, []{ bits[4] ^= 0x03; } );
+}
+
+static void timerInterrupt() {
+static const uint8_t counts[] = { 0, 8, 16, 32 };
+uint8_t n, cnt;
+	for ( n = 0; n < sizeof(counts); n++ ) {
+		fresh();
+		timerCount = counts[n];
+		for ( cnt = 0; cnt < MAXTIMERS; cnt++ ) timers[cnt] = UINT32_MAX;
+		timeIt( "tISR." + std::to_string( counts[n] ), ROUNDS, []{ tISR(); } );
+	}
+}
+
+// A ladder of n components of mixed types
+static void ladder( uint8_t n ) {
+uint8_t cnt;
+logicBit in, out;
+	for ( cnt = 0; cnt < n; cnt++ ) {
+		in = 32 + cnt % 16;
+		out = 48 + cnt % 16;
+		switch ( cnt % 8 ) {
+			case 0: new Logic2( in, in + 1, out, AND ); break;
+			case 1: new Not( in, out ); break;
+			case 2: new Bistable( in, in + 1, out ); break;
+			case 3: new Monostable( in, out, 50 ); break;
+			case 4: new CompareNumeric( cnt % 8, 8, out, GE ); break;
+			case 5: new Calc2( cnt % 8, 9, cnt % 8 + 1, PLUS ); break;
+			case 6: new UpCounter( in, in + 1, 10 ); break;
+			case 7: new Delay( in, in + 1, out, 10, 10 ); break;
+		}
+	}
+}
+
+// Scans of 8, 16, 32 ... components, the last one as many as MAXCOMPONENTS allows
+static void scans() {
+uint16_t n;
+	for ( n = 8; n < 2 * MAXCOMPONENTS; n *= 2 ) {
+		if ( n > MAXCOMPONENTS ) n = MAXCOMPONENTS;
+		fresh();
+		ladder( n );
+		timeIt( "scan." + std::to_string( n ), ROUNDS / n, []{ bits[4] ^= 0x55; CList.execute(); } );
+	}
+}
+
+// The conveyor lanes of lanes.h as a FunctionBlock and unrolled, a whole scan each
+static void lanes() {
+	fresh();
+	lanesUnrolled();
+	timeIt( "lanes.unrolled", ROUNDS / 80, []{ bits[4] ^= 0x24; bits[5] ^= 0x09; CList.execute(); } );
+	fresh();
+	lanesBlock();
+	timeIt( "lanes.FunctionBlock", ROUNDS / 80, []{ bits[4] ^= 0x24; bits[5] ^= 0x09; CList.execute(); } );
+}
+
+// A ring of 30 steps as a Sequencer and as the equivalent Bistable ladder, a whole scan each.
+// Every other condition is '1', so a step moves on most scans
+static void steps() {
+	fresh();
+	stepsSequencer();
+	memset( &bits[STEP_COND / 8], 0x55, ( STEPS + 7 ) / 8 );
+	timeIt( "steps.Sequencer", ROUNDS / 60, []{ bits[STEP_COND / 8] ^= 0xFF; CList.execute(); } );
+	fresh();
+	stepsLadder();
+	memset( &bits[STEP_COND / 8], 0x55, ( STEPS + 7 ) / 8 );
+	timeIt( "steps.Bistable", ROUNDS / 60, []{ bits[STEP_COND / 8] ^= 0xFF; CList.execute(); } );
+}
+
+// A fork is a snapshot and a restore of the whole run time state, see CList.snapshot()
+static std::map<std::string, uint16_t> snapshotBytes;
+static std::vector<uint8_t> blob;
+
+static void fork( const std::string &name ) {
+	blob.resize( CList.snapshotSize() );
+	snapshotBytes[name] = blob.size();
+	timeIt( "fork." + name, ROUNDS / 10, []{ CList.snapshot( blob.data() ); CList.restore( blob.data() ); } );
+}
+
+static void forks() {
+	fresh();
+	ladder( MAXCOMPONENTS );
+	fork( "scan." + std::to_string( MAXCOMPONENTS ) );
+	fresh();
+	lanesBlock();
+	fork( "lanes.FunctionBlock" );
+}
+
+static void forkRates() {
+	for ( const Result &r : results ) {
+		if ( r.name.compare( 0, 5, "fork." ) ) continue;
+		printf( "bench: %s: snapshot %u bytes, %.0f forks/s\n", r.name.c_str(), snapshotBytes[r.name.substr( 5 )], 1e9 / r.ns );
+	}
+}
+
+static void write( FILE *f ) {
+	fprintf( f, "benchmark,ns,relative\n" );
+	for ( const Result &r : results ) fprintf( f, "%s,%.2f,%.4f\n", r.name.c_str(), r.ns, r.rel );
+}
+
+// The relative costs are compared, the nanoseconds are only for reading
+static bool compare( const char *fileName, double tolerance ) {
+std::map<std::string, double> baseline;
+char line[128], *comma;
+FILE *f;
+bool ok = true;
+double ratio;
+	f = fopen( fileName, "r" );
+	if ( !f ) {
+		printf( "bench: cannot read baseline %s\n", fileName );
+		return false;
+	}
+	while ( fgets( line, sizeof(line), f ) ) {
+		comma = strchr( line, ',' );
+		if ( !comma || !strchr( comma + 1, ',' ) ) continue;
+		*comma = 0;
+		baseline[line] = atof( strchr( comma + 1, ',' ) + 1 );
+	}
+	fclose( f );
+	printf( "benchmark,ns,relative,baseline,ratio\n" );
+	for ( const Result &r : results ) {
+		if ( !baseline.count( r.name ) || baseline[r.name] <= 0 ) {
+			printf( "%s,%.2f,%.4f,,,NEW\n", r.name.c_str(), r.ns, r.rel );
+			continue;
+		}
+		ratio = r.rel / baseline[r.name];
+		printf( "%s,%.2f,%.4f,%.4f,%.2f", r.name.c_str(), r.ns, r.rel, baseline[r.name], ratio );
+		if ( ratio > 1 + tolerance ) {
+			printf( ",REGRESSION" );
+			ok = false;
+		}
+		printf( "\n" );
+	}
+	printf( "bench: %s (tolerance %.0f%%)\n", ok ? "ok" : "FAILED", tolerance * 100 );
+	return ok;
+}
+
+static bool byRel( const Result &a, const Result &b ) { return a.rel < b.rel; }
+static bool byNs( const Result &a, const Result &b ) { return a.ns < b.ns; }
+
+// Run the whole suite RUNS times and keep the median of each benchmark
+static void suite() {
+std::vector<Result> all;
+std::vector<Result> runs[RUNS];
+uint8_t run;
+size_t n;
+	for ( run = 0; run < RUNS; run++ ) {
+		results.clear();
+		components();
+		timerInterrupt();
+		scans();
+		lanes();
+		steps();
+		forks();
+		runs[run] = results;
+	}
+	for ( n = 0; n < results.size(); n++ ) {
+		all.clear();
+		for ( run = 0; run < RUNS; run++ ) all.push_back( runs[run][n] );
+		std::sort( all.begin(), all.end(), byRel );
+		results[n].rel = all[RUNS / 2].rel;
+		std::sort( all.begin(), all.end(), byNs );
+		results[n].ns = all[RUNS / 2].ns;
+	}
+}
+
+int main( int argc, char **argv ) {
+FILE *f;
+bool ok;
+	suite();
+	if ( argc >= 3 && !strcmp( argv[1], "--write" ) ) {
+		f = fopen( argv[2], "w" );
+		if ( !f ) {
+			printf( "bench: cannot write %s\n", argv[2] );
+			return 1;
+		}
+		write( f );
+		fclose( f );
+		printf( "bench: baseline written to %s\n", argv[2] );
+		forkRates();
+		return 0;
+	}
+	if ( argc >= 3 && !strcmp( argv[1], "--compare" ) ) {
+		ok = compare( argv[2], argc >= 4 ? atof( argv[3] ) : TOLERANCE );
+		forkRates();
+		return ok ? 0 : 1;
+	}
+	write( stdout );
+	forkRates();
+	return 0;
+}
@@ -0,0 +1,12 @@
+/*
+ * bench_ladder.h
+ *
+ * Ladder header of the host benchmark (PLC_LADDER_FILE). The benchmark builds its fixtures
+ * at run time, so the ladder itself is empty and only reserves the resources they need.
+ */
+
+#define PLC_LADDER(X)
+#define PLC_EXTRA_COMPONENTS 96
+#define PLC_EXTRA_TIMERS 32
+#define PLC_MIN_BITSPACE 32
+#define PLC_MIN_INTSPACE 32
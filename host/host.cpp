@@ -0,0 +1,346 @@
+/*
+ * host.cpp
+ *
+ * Implementation of the stub headers and the virtual time of host.h
+ */
+
+#include <stdlib.h>
+#include <SPI.h>
+#include <TimerOne.h>
+#include <avr/eeprom.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+#include <util/twi.h>
+#include "host.h"
+
+uint32_t hostMicros = 0;
+uint16_t hostInputs = 0;
+uint16_t hostOutputs = 0;
+uint32_t hostOutputTime = 0;
+uint32_t hostTransfers = 0;
+uint16_t hostAnalog[6];
+uint16_t hostPwm[14];
+uint8_t hostEeprom[E2END + 1];
+uint32_t hostEepromWrites = 0;
+uint32_t hostEepromReads = 0;
+uint32_t hostEepromCellWrites[E2END + 1];
+uint32_t hostEepromStalls = 0;
+bool hostWdtEnabled = false;
+uint32_t hostWdtResets = 0;
+int hostFailures = 0;
+
+std::string hostSerial;
+HostSerial Serial;
+HostSPI SPI;
+HostTimerOne Timer1;
+volatile uint8_t MCUSR;
+HostTwi hostTwi[HOST_NODES];
+uint8_t hostNode = 0;
+uint32_t hostBusMessages = 0;
+uint32_t hostBusBytes = 0;
+uint32_t hostBusArbLost = 0;
+uint32_t hostBusBusyMicros = 0;
+
+static uint32_t tickPeriod = 0;
+static uint32_t nextTick = 0;
+static void (*timerIsr[HOST_NODES])();
+static bool timerOn = false;				// some node has a timer interrupt attached
+static void (*pinIsr)() = NULL;
+static uint32_t eepromReadyAt = 0;
+
+// Scheduled input changes, kept in time order
+#define HOST_EVENTS 64
+static uint32_t eventTime[HOST_EVENTS];
+static uint16_t eventInputs[HOST_EVENTS];
+static uint8_t nEvents = 0;
+
+// The simulated I2C bus. Each phase (START, a byte, STOP) is one event in virtual time
+enum { BUS_IDLE, BUS_START, BUS_BYTE, BUS_STOP };
+static void (*busIsr[HOST_NODES])();		// TWI interrupt handler of each attached node
+static uint8_t busDeaf[HOST_NODES];			// messages still to be missed by each node
+static uint8_t busState = BUS_IDLE;
+static uint32_t busNext;					// when the current phase ends
+static uint32_t busBit;						// one SCL period
+static uint32_t busStarted;
+static uint16_t busMasters;					// nodes sending the current message, a bit each
+static uint16_t busReceivers;				// nodes receiving it
+static bool busAddress;						// the next byte is the address
+static bool busAcked;						// the last byte was acknowledged
+
+static struct HostEepromInit {
+	HostEepromInit() { memset( hostEeprom, 0xFF, sizeof(hostEeprom) ); }
+} hostEepromInit;
+
+// Run the TWI interrupt handler of 'node' with TWSR set to 'status'
+static void busInterrupt( uint8_t node, uint8_t status ) {
+uint8_t running;
+	running = hostNode;
+	hostNode = node;
+	TWSR = status;
+	busIsr[node]();
+	hostNode = running;
+}
+
+// An idle bus is taken by the nodes that asked for a START. Those that ask before the START
+// condition is on the bus start together and arbitrate.
+static void busPoll() {
+uint8_t node;
+	if ( busState != BUS_IDLE ) return;
+	for ( node = 0; node < HOST_NODES; node++ ) {
+		if ( busIsr[node] && ( hostTwi[node].twcr & _BV(TWSTA) ) ) break;
+	}
+	if ( node == HOST_NODES ) return;
+	busBit = ( 16 + 2 * hostTwi[node].twbr ) / ( F_CPU / 1000000 );	// prescaler 1
+	busStarted = hostMicros;
+	busNext = hostMicros + busBit;
+	busState = BUS_START;
+}
+
+// After the masters have had their interrupt: STOP if they all asked for it, else the next byte
+static void busNextPhase() {
+uint8_t node;
+	busState = BUS_STOP;
+	for ( node = 0; node < HOST_NODES; node++ ) {
+		if ( ( busMasters & _BV(node) ) && !( hostTwi[node].twcr & _BV(TWSTO) ) ) busState = BUS_BYTE;
+	}
+	busNext += busState == BUS_STOP ? busBit : 9 * busBit;
+}
+
+// End of the current bus phase
+static void busStep() {
+uint8_t node, value;
+uint16_t ack;
+	switch ( busState ) {
+		case BUS_START:
+			busMasters = 0;
+			busReceivers = 0;
+			for ( node = 0; node < HOST_NODES; node++ ) {
+				if ( busIsr[node] && ( hostTwi[node].twcr & _BV(TWSTA) ) ) busMasters |= _BV(node);
+			}
+			for ( node = 0; node < HOST_NODES; node++ ) {
+				if ( busMasters & _BV(node) ) busInterrupt( node, TW_START );
+			}
+			busAddress = true;
+			busNextPhase();
+			break;
+		case BUS_BYTE:
+			// Wired AND, most significant bit first: the lowest byte wins and every master
+			// that sent another one (or a STOP) has lost arbitration
+			value = 0xFF;
+			for ( node = 0; node < HOST_NODES; node++ ) {
+				if ( ( busMasters & _BV(node) ) && !( hostTwi[node].twcr & _BV(TWSTO) ) && hostTwi[node].twdr < value ) value = hostTwi[node].twdr;
+			}
+			for ( node = 0; node < HOST_NODES; node++ ) {
+				if ( ( busMasters & _BV(node) ) && ( ( hostTwi[node].twcr & _BV(TWSTO) ) || hostTwi[node].twdr != value ) ) {
+					busMasters &= ~_BV(node);
+					hostBusArbLost++;
+					busInterrupt( node, TW_MT_ARB_LOST );
+				}
+			}
+			ack = 0;
+			if ( busAddress ) {		// only general calls (address 0, write) have receivers
+				for ( node = 0; node < HOST_NODES && value == 0x00; node++ ) {
+					if ( !busIsr[node] || ( busMasters & _BV(node) ) ) continue;
+					if ( !( hostTwi[node].twar & _BV(TWGCE) ) || !( hostTwi[node].twcr & _BV(TWEA) ) ) continue;
+					if ( busDeaf[node] ) busDeaf[node]--;
+					else busReceivers |= _BV(node);
+				}
+				ack = busReceivers;
+				for ( node = 0; node < HOST_NODES; node++ ) {
+					if ( busReceivers & _BV(node) ) busInterrupt( node, TW_SR_GCALL_ACK );
+				}
+			}
+			else {
+				for ( node = 0; node < HOST_NODES; node++ ) {
+					if ( !( busReceivers & _BV(node) ) ) continue;
+					if ( hostTwi[node].twcr & _BV(TWEA) ) {
+						ack |= _BV(node);
+						hostTwi[node].twdr = value;
+						busInterrupt( node, TW_SR_GCALL_DATA_ACK );
+					}
+					else busReceivers &= ~_BV(node);	// not addressed any more
+				}
+				if ( ack ) hostBusBytes++;
+			}
+			busAcked = ( ack != 0 );
+			for ( node = 0; node < HOST_NODES; node++ ) {
+				if ( !( busMasters & _BV(node) ) ) continue;
+				if ( busAddress ) busInterrupt( node, ack ? TW_MT_SLA_ACK : TW_MT_SLA_NACK );
+				else busInterrupt( node, ack ? TW_MT_DATA_ACK : TW_MT_DATA_NACK );
+			}
+			busAddress = false;
+			busNextPhase();
+			break;
+		case BUS_STOP:
+			for ( node = 0; node < HOST_NODES; node++ ) {
+				if ( busMasters & _BV(node) ) hostTwi[node].twcr &= ~_BV(TWSTO);
+			}
+			for ( node = 0; node < HOST_NODES; node++ ) {
+				if ( busReceivers & _BV(node) ) busInterrupt( node, TW_SR_STOP );
+			}
+			if ( busAcked ) hostBusMessages++;
+			hostBusBusyMicros += busNext - busStarted;
+			busState = BUS_IDLE;
+			break;
+	}
+}
+
+void hostAdvance( uint32_t micros ) {
+uint32_t target;
+uint8_t cnt, running;
+	target = hostMicros + micros;
+	for ( ;; ) {
+		busPoll();
+		if ( busState != BUS_IDLE && busNext <= target && ( !timerOn || busNext <= nextTick ) && ( !nEvents || busNext <= eventTime[0] ) ) {
+			if ( busNext > hostMicros ) hostMicros = busNext;
+			busStep();
+		}
+		else if ( nEvents && ( !timerOn || eventTime[0] <= nextTick ) && eventTime[0] <= target ) {
+			if ( eventTime[0] > hostMicros ) hostMicros = eventTime[0];
+			hostInputs = eventInputs[0];
+			for ( cnt = 1; cnt < nEvents; cnt++ ) {
+				eventTime[cnt - 1] = eventTime[cnt];
+				eventInputs[cnt - 1] = eventInputs[cnt];
+			}
+			nEvents--;
+			if ( pinIsr ) pinIsr();
+		}
+		else if ( timerOn && nextTick <= target ) {
+			if ( nextTick > hostMicros ) hostMicros = nextTick;
+			nextTick += tickPeriod;
+			running = hostNode;
+			for ( hostNode = 0; hostNode < HOST_NODES; hostNode++ ) {
+				if ( timerIsr[hostNode] ) timerIsr[hostNode]();
+			}
+			hostNode = running;
+		}
+		else break;
+	}
+	if ( target > hostMicros ) hostMicros = target;	// (an interrupt handler may have used time of its own)
+}
+
+void hostSetInputs( uint16_t inputs, uint32_t at ) {
+uint8_t pos;
+#ifdef INVERT_INPUTS
+	inputs = ~inputs;
+#endif
+	if ( nEvents == HOST_EVENTS ) {
+		printf( "hostSetInputs: too many scheduled changes\n" );
+		exit( 1 );
+	}
+	for ( pos = nEvents; pos > 0 && eventTime[pos - 1] > at; pos-- ) {
+		eventTime[pos] = eventTime[pos - 1];
+		eventInputs[pos] = eventInputs[pos - 1];
+	}
+	eventTime[pos] = at;
+	eventInputs[pos] = inputs;
+	nEvents++;
+}
+
+void hostReset() {
+	hostMicros = 0;
+	hostOutputs = 0;
+	hostOutputTime = 0;
+	hostTransfers = 0;
+#ifdef INVERT_INPUTS
+	hostInputs = 0xFFFF;
+#else
+	hostInputs = 0;
+#endif
+	hostWdtEnabled = false;
+	memset( timerIsr, 0, sizeof(timerIsr) );
+	timerOn = false;
+	memset( hostTwi, 0, sizeof(hostTwi) );
+	memset( busIsr, 0, sizeof(busIsr) );
+	memset( busDeaf, 0, sizeof(busDeaf) );
+	busState = BUS_IDLE;
+	hostBusMessages = 0;
+	hostBusBytes = 0;
+	hostBusArbLost = 0;
+	hostBusBusyMicros = 0;
+	hostNode = 0;
+	pinIsr = NULL;
+	nEvents = 0;
+	eepromReadyAt = 0;
+	timerCount = 0;
+	tickCount = 0;
+	hostSerial.clear();
+}
+
+void hostBusAttach( uint8_t node, void (*isr)() ) { busIsr[node] = isr; }
+
+void hostBusDeaf( uint8_t node, uint8_t messages ) { busDeaf[node] = messages; }
+
+void pinMode( uint8_t pin, uint8_t mode ) {}
+void digitalWrite( uint8_t pin, uint8_t value ) {}
+int digitalRead( uint8_t pin ) { return LOW; }
+
+int analogRead( uint8_t pin ) {
+	if ( pin < 18 || pin > 23 ) {
+		printf( "analogRead: pin %d is not an analog input\n", pin );
+		exit( 1 );
+	}
+	return hostAnalog[pin - 18];
+}
+
+void analogWrite( uint8_t pin, int value ) { hostPwm[pin] = value; }
+
+unsigned long micros() { return hostMicros; }
+
+void cli() {}
+void sei() {}
+
+void attachInterrupt( uint8_t interrupt, void (*handler)(), int mode ) { pinIsr = handler; }
+
+uint16_t HostSPI::transfer16( uint16_t data ) {
+	hostAdvance( HOST_SPI_MICROS );
+	hostTransfers++;
+	if ( data != hostOutputs ) {
+		hostOutputs = data;
+		hostOutputTime = hostMicros;
+	}
+	return hostInputs;
+}
+
+void HostTimerOne::initialize( uint32_t period ) { tickPeriod = period; }
+
+void HostTimerOne::attachInterrupt( void (*isr)() ) {
+	timerIsr[hostNode] = isr;
+	timerOn = true;
+	nextTick = hostMicros + tickPeriod;
+}
+
+void HostTimerOne::pwm( uint8_t pin, uint16_t duty ) { hostPwm[pin] = duty; }
+void HostTimerOne::setPwmDuty( uint8_t pin, uint16_t duty ) { hostPwm[pin] = duty; }
+
+bool eeprom_is_ready() { return hostMicros >= eepromReadyAt; }
+
+uint8_t eeprom_read_byte( const uint8_t *address ) {
+	if ( !eeprom_is_ready() ) hostEepromStalls++;
+	hostEepromReads++;
+	return hostEeprom[(uintptr_t)address];
+}
+
+void eeprom_write_byte( uint8_t *address, uint8_t value ) {
+	if ( !eeprom_is_ready() ) {
+		hostEepromStalls++;
+		eepromReadyAt += HOST_EEPROM_MICROS;
+	}
+	else eepromReadyAt = hostMicros + HOST_EEPROM_MICROS;
+	hostEeprom[(uintptr_t)address] = value;
+	hostEepromCellWrites[(uintptr_t)address]++;
+	hostEepromWrites++;
+}
+
+// Sleep until the next interrupt
+void sleep_cpu() {
+uint32_t wake;
+	if ( !timerOn && !nEvents ) {
+		printf( "sleep_cpu: nothing would ever wake the processor\n" );
+		exit( 1 );
+	}
+	wake = timerOn ? nextTick : eventTime[0];
+	if ( nEvents && eventTime[0] < wake ) wake = eventTime[0];
+	if ( wake < hostMicros ) wake = hostMicros;
+	hostAdvance( wake - hostMicros );
+}
@@ -0,0 +1,90 @@
+/*
+ * host.h
+ *
+ * Host (PC) simulation of the IO expander board for the tests and benchmarks in this directory.
+ * plc.cpp is compiled unchanged against the stub headers in host/stubs.
+ *
+ * Time is virtual and only moves in hostAdvance(). Whatever falls due on the way is run in order:
+ * the Timer1 interrupt every TIMERTICK and the input changes scheduled with hostSetInputs().
+ * Hardware that takes time advances it too: an SPI transfer takes HOST_SPI_MICROS and an EEPROM
+ * byte write keeps the EEPROM busy for HOST_EEPROM_MICROS. Everything else takes no time at all,
+ * so a test models the cost of a scan by adding components that call hostAdvance().
+ *
+ * Several PLC nodes can run in one process, each a copy of plc.cpp in a namespace of its own
+ * (see linknode.cpp). hostNode is the node whose code is running; it selects that node's TWI
+ * registers and Timer1 interrupt. Nodes attached with hostBusAttach() share a simulated I2C bus:
+ * an idle bus is taken by the nodes that set TWSTA, every byte takes 9 SCL periods at the clock
+ * set by TWBR, arbitration is by wired AND (the lower byte wins, the others get TW_MT_ARB_LOST and
+ * miss the message) and general calls are received by every other node with TWEA set.
+ */
+
+#ifndef HOST_H_
+#define HOST_H_
+
+#include <stdio.h>
+#include "plc.h"
+
+#define HOST_SPI_MICROS 20			// 16 bits at SPICLOCK 1 MHz plus the strobes
+#define HOST_EEPROM_MICROS 3400		// ATmega32U4 EEPROM erase + write cycle
+
+extern uint32_t hostMicros;			// virtual time
+extern uint16_t hostInputs;			// raw input image shifted in from the 165s
+extern uint16_t hostOutputs;		// output image last latched into the 595s
+extern uint32_t hostOutputTime;		// hostMicros when hostOutputs last changed
+extern uint32_t hostTransfers;		// number of SPI transfers
+extern uint16_t hostAnalog[6];		// analogRead() values of channels 0...5
+extern uint16_t hostPwm[14];		// last duty written to each PWM pin
+extern uint8_t hostEeprom[E2END + 1];
+extern uint32_t hostEepromWrites;	// EEPROM bytes written
+extern uint32_t hostEepromReads;	// EEPROM bytes read
+extern uint32_t hostEepromCellWrites[E2END + 1];	// writes of each EEPROM byte
+extern uint32_t hostEepromStalls;	// EEPROM accesses that had to wait for a write to finish
+extern bool hostWdtEnabled;
+extern uint32_t hostWdtResets;
+extern int hostFailures;
+extern uint32_t hostBusMessages;	// I2C messages completed with an acknowledge
+extern uint32_t hostBusBytes;		// I2C data bytes acknowledged
+extern uint32_t hostBusArbLost;		// lost arbitrations
+extern uint32_t hostBusBusyMicros;	// time the I2C bus was busy
+
+// The library's own globals, for tests that need to look inside
+extern uint8_t bits[BITSPACE];
+extern uint16_t ints[INTSPACE];
+extern uint8_t timerCount;
+extern volatile uint32_t timers[MAXTIMERS];
+extern volatile uint32_t tickCount;
+
+// Let 'micros' of virtual time pass
+void hostAdvance( uint32_t micros );
+
+// At virtual time 'at', change the inputs so that the ladder sees 'inputs' as bits 0...15.
+// The event pin interrupt (if attached) fires as well, as if EVENT_PIN were wired to the changing input.
+void hostSetInputs( uint16_t inputs, uint32_t at );
+
+// Power on: virtual time back to 0, nothing scheduled or attached, outputs cleared, bus idle.
+// The EEPROM keeps its contents. Call CList.begin() and build the ladder after this.
+void hostReset();
+
+// Attach node 'node' with TWI interrupt handler 'isr' to the simulated I2C bus
+void hostBusAttach( uint8_t node, void (*isr)() );
+
+// Node 'node' misses the next 'messages' messages on the bus, as if disturbed
+void hostBusDeaf( uint8_t node, uint8_t messages );
+
+// Burns 'cost' microseconds of virtual time every time it is executed, to give a scan a duration
+class HostLoad: public Component {
+public:
+	HostLoad(uint32_t micros):Component(0, 0) { cost = micros; };
+	uint32_t cost;
+private:
+	void execute() { hostAdvance( cost ); };
+};
+
+#define CHECK(cond) do { \
+	if ( !(cond) ) { \
+		printf( "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond ); \
+		hostFailures++; \
+	} \
+} while ( 0 )
+
+#endif /* HOST_H_ */
@@ -0,0 +1,77 @@
+/*
+ * lanes.h
+ *
+ * The conveyor lane ladder of the FunctionBlock comparison, shared by test_functionblock.cpp
+ * and the benchmark: a 10 component lane built either once as a FunctionBlock with an instance
+ * per lane, or unrolled with a copy of every component per lane. Build with bench_ladder.h.
+ *
+ * Lane k: inputs start 32+3k, stop 33+3k and item sensor 34+3k, outputs motor 56+k and jam 64+k,
+ * item count in numeric 16+k.
+ */
+
+#ifndef LANES_H_
+#define LANES_H_
+
+#include "host.h"
+
+#define LANES 8
+#define LANE_BITS 16				// window bits 80...95, of which 80...82 inputs and 83...84 outputs
+#define LANE_WINDOW 80
+#define LANE_UNROLLED 96			// first bit of the local bits of the unrolled lanes, LANE_BITS per lane
+
+struct LaneMap {
+	logicBit param[5];				// start, stop, sensor, motor, jam
+	logicBit local;					// where window bit LANE_WINDOW + 5 goes
+	numeric count;
+	logicBit b( uint8_t window ) const {
+		return window < LANE_WINDOW + 5 ? param[window - LANE_WINDOW] : local + window - LANE_WINDOW - 5;
+	}
+};
+
+static LaneMap laneMap( uint8_t k ) {
+LaneMap m = { { (logicBit)( 32 + 3 * k ), (logicBit)( 33 + 3 * k ), (logicBit)( 34 + 3 * k ),
+	(logicBit)( 56 + k ), (logicBit)( 64 + k ) }, (logicBit)( LANE_UNROLLED + LANE_BITS * k ), (numeric)( 16 + k ) };
+	return m;
+}
+
+// The body of a lane on window bits (mapped through m) and numeric 'count'
+static void laneBody( const LaneMap &m ) {
+	new Bistable( m.b(80), m.b(85), m.b(86) );			// running: set by start, reset by stop or jam
+	new Logic2( m.b(81), m.b(84), m.b(85), OR );
+	new Monostable( m.b(82), m.b(87), 50 );				// an item passes the sensor
+	new UpCounter( m.b(87), m.b(81), m.count );			// items since the last stop
+	new Not( m.b(82), m.b(88) );
+	new Logic2( m.b(86), m.b(88), m.b(89), AND );		// running with no item in sight ...
+	new Delay( m.b(89), m.b(82), m.b(90), 300, 10 );	// ... for 300 ticks is a jam
+	new Bistable( m.b(90), m.b(81), m.b(84) );
+	new Not( m.b(84), m.b(91) );
+	new Logic2( m.b(86), m.b(91), m.b(83), AND );		// motor
+}
+
+// The identity map of the FunctionBlock window
+static LaneMap windowMap() {
+LaneMap m = { { 80, 81, 82, 83, 84 }, 85, 8 };
+	return m;
+}
+
+static FunctionBlock *lanesBlock() {
+FunctionBlock *fb;
+LaneMap m;
+uint8_t k;
+	fb = new FunctionBlock( LANE_WINDOW / 8, LANE_BITS / 8, 3, 2, 8, 1, 0, 1, LANES );
+	fb->define();
+	laneBody( windowMap() );
+	fb->endDefine();
+	for ( k = 0; k < LANES; k++ ) {
+		m = laneMap( k );
+		fb->instance( m.param, &m.count );
+	}
+	return fb;
+}
+
+static void lanesUnrolled() {
+uint8_t k;
+	for ( k = 0; k < LANES; k++ ) laneBody( laneMap( k ) );
+}
+
+#endif /* LANES_H_ */
@@ -0,0 +1,11 @@
+/*
+ * link_ladder.h
+ *
+ * Ladder header of the I2CLINK test (PLC_LADDER_FILE): no components, but variable spaces large
+ * enough to publish more than 255 bytes.
+ */
+
+#define PLC_LADDER(X)
+#define PLC_EXTRA_COMPONENTS 1
+#define PLC_MIN_BITSPACE 40
+#define PLC_MIN_INTSPACE 200
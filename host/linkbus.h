@@ -0,0 +1,28 @@
+/*
+ * linkbus.h
+ *
+ * The PLC nodes of test_linkbus. Each node is a complete copy of plc.cpp compiled into a namespace
+ * of its own (linknode.cpp, once per node) and is reached through a LinkNode of plain pointers.
+ * Built with -DI2CLINK -DLINK_NODES=HOST_NODES and link_ladder.h, see the Makefile.
+ */
+
+#ifndef LINKBUS_H_
+#define LINKBUS_H_
+
+#include <arduino.h>
+
+struct LinkNode {
+	void (*powerOn)();					// tickCount back to 0 and CList.begin()
+	void (*execute)();					// one scan
+	void (*linkBegin)( uint8_t node, uint16_t bitFirst, uint16_t bitLast, uint8_t intFirst, uint8_t intLast );
+	uint32_t (*linkAge)( uint8_t node );
+	uint16_t (*linkErrors)( uint8_t node );
+	uint16_t (*linkTxErrors)();
+	bool (*linkReady)();				// nothing being sent and free to send (plc.cpp internals)
+	void (*twi)();						// TWI interrupt handler
+	uint8_t *bits;
+	uint16_t *ints;
+};
+extern LinkNode linkNodes[HOST_NODES];
+
+#endif /* LINKBUS_H_ */
@@ -0,0 +1,43 @@
+/*
+ * linknode.cpp
+ *
+ * One PLC node of test_linkbus: plc.cpp compiled into namespace node<HOST_NODE>, so that several
+ * PLCs, each with its own variables, timers and link state, run in one process. The stub headers
+ * are included first, outside the namespace; the node registers itself in linkNodes[HOST_NODE].
+ */
+
+#include <SPI.h>
+#include <TimerOne.h>
+#include <avr/eeprom.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+#include <util/twi.h>
+#include "linkbus.h"
+
+#define NODE_NAMESPACE_(n) node##n
+#define NODE_NAMESPACE(n) NODE_NAMESPACE_(n)
+
+namespace NODE_NAMESPACE(HOST_NODE) {
+
+#include "../plc.cpp"
+
+static struct Register {
+	Register() {
+		linkNodes[HOST_NODE] = {
+			[]() { tickCount = 0; CList.begin(); },
+			[]() { CList.execute(); },
+			[]( uint8_t node, uint16_t bitFirst, uint16_t bitLast, uint8_t intFirst, uint8_t intLast ) {
+				CList.linkBegin( node, bitFirst, bitLast, intFirst, intLast );
+			},
+			[]( uint8_t node ) { return CList.linkAge( node ); },
+			[]( uint8_t node ) { return CList.linkErrors( node ); },
+			[]() { return CList.linkTxErrors(); },
+			[]() { return !linkTxBusy && tickCount - linkTxDone >= linkTxShare; },
+			TWI_vect,
+			bits,
+			ints
+		};
+	}
+} registerNode;
+
+}
@@ -0,0 +1,67 @@
+/*
+ * lintable.cpp
+ *
+ * Table generator for the Linearize component: reads a sensor curve and writes a PROGMEM
+ * breakpoint table of at most POINTS points that approximates it, with the error report.
+ *
+ *   lintable NAME POINTS [FILE]
+ *
+ * The curve (FILE or standard input) has one sample "x y" per line, x being the input numeric
+ * (e.g. the AnalogIn value) and y the wanted output numeric, both 0...65535 (y may have decimals).
+ * Lines starting with '#' are skipped. Sample the curve densely: the error is only checked at the samples.
+ * The error is measured by running the table through the Linearize component itself.
+ */
+
+#include <stdlib.h>
+#include <algorithm>
+#include "lintable.h"
+
+static bool byX( const CurvePoint &a, const CurvePoint &b ) { return a.x < b.x; }
+static bool sameX( const CurvePoint &a, const CurvePoint &b ) { return a.x == b.x; }
+
+int main( int argc, char **argv ) {
+std::vector<CurvePoint> curve;
+std::vector<uint16_t> table;
+LintableError e;
+FILE *f;
+char line[128];
+double x, y;
+int points;
+size_t cnt;
+	if ( argc < 3 || ( points = atoi( argv[2] ) ) < 2 || points > 255 ) {
+		fprintf( stderr, "usage: lintable NAME POINTS [FILE]   (2 <= POINTS <= 255)\n" );
+		return 1;
+	}
+	f = argc > 3 ? fopen( argv[3], "r" ) : stdin;
+	if ( !f ) {
+		fprintf( stderr, "lintable: cannot read %s\n", argv[3] );
+		return 1;
+	}
+	while ( fgets( line, sizeof(line), f ) ) {
+		if ( line[0] == '#' || sscanf( line, "%lf %lf", &x, &y ) != 2 ) continue;
+		if ( x < 0 || x > 65535 || y < 0 || y > 65535 ) {
+			fprintf( stderr, "lintable: sample %g %g is outside 0...65535\n", x, y );
+			return 1;
+		}
+		curve.push_back( CurvePoint{ lintableRound( x ), y } );
+	}
+	if ( f != stdin ) fclose( f );
+	std::stable_sort( curve.begin(), curve.end(), byX );
+	curve.erase( std::unique( curve.begin(), curve.end(), sameX ), curve.end() );
+	if ( curve.size() < 2 ) {
+		fprintf( stderr, "lintable: the curve needs at least 2 samples with different x\n" );
+		return 1;
+	}
+	table = lintableFit( curve, points );
+	e = lintableError( curve, table );
+	printf( "// %s: %u points fitted to %u samples, x %u...%u\n", argv[1], (unsigned)( table.size() / 2 ),
+		(unsigned)curve.size(), curve.front().x, curve.back().x );
+	printf( "// error: max %.2f at x = %u, mean %.2f. Use: new Linearize( in, out, %s, %u );\n",
+		e.max, e.maxAt, e.mean, argv[1], (unsigned)( table.size() / 2 ) );
+	printf( "static const uint16_t %s[] PROGMEM = {\n", argv[1] );
+	for ( cnt = 0; cnt < table.size(); cnt += 2 ) {
+		printf( "\t%u, %u%s\n", table[cnt], table[cnt + 1], cnt + 2 < table.size() ? "," : "" );
+	}
+	printf( "};\n" );
+	return 0;
+}
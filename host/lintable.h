@@ -0,0 +1,104 @@
+/*
+ * lintable.h
+ *
+ * Fitting of a Linearize breakpoint table to a sensor curve, for the table generator
+ * (lintable.cpp) and its test. The curve is a list of samples (x, y) in the units of
+ * the ladder numerics, sorted by x. The breakpoints are picked among the samples, as few as
+ * keep every sample within the error, and the smallest error that fits in the points wanted.
+ */
+
+#ifndef LINTABLE_H_
+#define LINTABLE_H_
+
+#include <math.h>
+#include <vector>
+#include "host.h"
+
+struct CurvePoint {
+	uint16_t x;
+	double y;
+};
+
+static uint16_t lintableRound( double y ) {
+	if ( y < 0 ) return 0;
+	if ( y > 65535 ) return 65535;
+	return (uint16_t)( y + 0.5 );
+}
+
+// Largest error of the samples lo...hi against the segment between samples lo and hi
+static double lintableSegmentError( const std::vector<CurvePoint> &curve, size_t lo, size_t hi ) {
+uint16_t x0, x1, y0, y1;
+size_t k;
+double err = 0, y;
+	x0 = curve[lo].x;
+	x1 = curve[hi].x;
+	y0 = lintableRound( curve[lo].y );
+	y1 = lintableRound( curve[hi].y );
+	for ( k = lo; k <= hi; k++ ) {
+		// the interpolation of Linearize::execute(), rounded towards y0
+		if ( y1 >= y0 ) y = y0 + (uint32_t)( y1 - y0 ) * ( curve[k].x - x0 ) / ( x1 - x0 );
+		else y = y0 - (uint32_t)( y0 - y1 ) * ( curve[k].x - x0 ) / ( x1 - x0 );
+		err = fmax( err, fabs( y - curve[k].y ) );
+	}
+	return err;
+}
+
+// Breakpoints (sample indexes) keeping every sample within maxErr, each segment as long as it can be
+static std::vector<size_t> lintableBreaks( const std::vector<CurvePoint> &curve, double maxErr ) {
+std::vector<size_t> breaks;
+size_t lo, hi;
+	breaks.push_back( 0 );
+	for ( lo = 0; lo < curve.size() - 1; lo = hi ) {
+		for ( hi = lo + 1; hi + 1 < curve.size() && lintableSegmentError( curve, lo, hi + 1 ) <= maxErr; hi++ ) ;
+		breaks.push_back( hi );
+	}
+	return breaks;
+}
+
+// Fit at most 'points' breakpoints to the curve. Returns the table as x, y pairs
+static std::vector<uint16_t> lintableFit( const std::vector<CurvePoint> &curve, uint8_t points ) {
+std::vector<size_t> breaks;
+std::vector<uint16_t> table;
+double lo = 0, hi = 65536, mid;
+uint8_t cnt;
+	for ( cnt = 0; cnt < 40; cnt++ ) {
+		mid = ( lo + hi ) / 2;
+		if ( lintableBreaks( curve, mid ).size() <= points ) hi = mid;
+		else lo = mid;
+	}
+	breaks = lintableBreaks( curve, hi );
+	for ( size_t b : breaks ) {
+		table.push_back( curve[b].x );
+		table.push_back( lintableRound( curve[b].y ) );
+	}
+	return table;
+}
+
+struct LintableError {
+	double max, mean;
+	uint16_t maxAt;				// x of the largest error
+};
+
+// The error of the table over the samples, evaluated with the Linearize component itself
+// on a ladder of its own (power on, input numeric 0, output numeric 1)
+static LintableError lintableError( const std::vector<CurvePoint> &curve, const std::vector<uint16_t> &table ) {
+LintableError e = { 0, 0, 0 };
+double err;
+	hostReset();
+	CList.begin();
+	new Linearize( 0, 1, table.data(), table.size() / 2 );
+	for ( const CurvePoint &p : curve ) {
+		ints[0] = p.x;
+		CList.execute();
+		err = fabs( ints[1] - p.y );
+		e.mean += err;
+		if ( err > e.max ) {
+			e.max = err;
+			e.maxAt = p.x;
+		}
+	}
+	e.mean /= curve.size();
+	return e;
+}
+
+#endif /* LINTABLE_H_ */
@@ -0,0 +1,27 @@
+/*
+ * resources.cpp
+ *
+ * Prints the sizes a ladder header (PLC_LADDER_FILE, see plcladder.h) gives: BITSPACE, INTSPACE,
+ * MAXTIMERS and MAXCOMPONENTS, and the RAM the variables, timers and component list take on the
+ * ATmega32U4. The components themselves are not in that figure, because their sizes on the PC
+ * are not those on the AVR: plcRamBytes counts them on the target (PLC_RAM_LIMIT, listResources()).
+ *
+ *   make resources LADDER=<ladder header>
+ */
+
+#include "host.h"
+
+#ifndef PLC_LADDER_FILE
+#error "resources: give the ladder header with LADDER=<file>"
+#endif
+
+// Sizes on the ATmega32U4: a numeric 2 bytes, a timer 4, a pointer in the component list 2
+#define AVR_RAM ( BITSPACE + 2 * INTSPACE + 4 * MAXTIMERS + 2 * MAXCOMPONENTS )
+
+int main() {
+	printf( "%s: BITSPACE %u, INTSPACE %u, MAXTIMERS %u, MAXCOMPONENTS %u\n", PLC_LADDER_FILE,
+		(unsigned)BITSPACE, (unsigned)INTSPACE, (unsigned)MAXTIMERS, (unsigned)MAXCOMPONENTS );
+	printf( "%s: variables, timers and component list take %u bytes of RAM on the ATmega32U4, the components come on top\n",
+		PLC_LADDER_FILE, (unsigned)AVR_RAM );
+	return 0;
+}
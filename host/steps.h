@@ -0,0 +1,36 @@
+/*
+ * steps.h
+ *
+ * The step chain of the Sequencer comparison, shared by test_sequencer.cpp and the benchmark:
+ * a ring of STEPS steps, each left when its condition bit is '1', built either as a Sequencer
+ * or as the equivalent ladder of one Logic2 AND and one Bistable per step. Build with bench_ladder.h.
+ */
+
+#ifndef STEPS_H_
+#define STEPS_H_
+
+#include "host.h"
+
+#define STEPS 30
+#define STEP_COND 32				// condition bits 32 ... 32 + STEPS - 1
+#define STEP_SEQ 128				// step bits of the Sequencer
+#define STEP_LADDER 160				// step bits of the Bistable ladder
+#define STEP_TRIG 192				// transition bits of the Bistable ladder
+
+static Sequencer *stepsSequencer() {
+Sequencer *seq;
+uint8_t k;
+	seq = new Sequencer( 0, STEP_SEQ, STEPS, STEPS, 0 );
+	for ( k = 0; k < STEPS; k++ ) seq->transition( k, ( k + 1 ) % STEPS, STEP_COND + k, 0 );
+	return seq;
+}
+
+// All the transitions are evaluated before any step moves, as in the Sequencer
+static void stepsLadder() {
+uint8_t k;
+	for ( k = 0; k < STEPS; k++ ) new Logic2( STEP_LADDER + k, STEP_COND + k, STEP_TRIG + k, AND );
+	for ( k = 0; k < STEPS; k++ ) new Bistable( STEP_TRIG + ( k + STEPS - 1 ) % STEPS, STEP_TRIG + k, STEP_LADDER + k );
+	setBit( STEP_LADDER, true );
+}
+
+#endif /* STEPS_H_ */
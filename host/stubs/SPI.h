@@ -0,0 +1,28 @@
+/*
+ * SPI.h (host stub)
+ *
+ * transfer16() latches the output image into hostOutputs and returns hostInputs (as read
+ * from the 165s, i.e. before INVERT_INPUTS). A transfer takes HOST_SPI_MICROS of virtual time.
+ */
+
+#ifndef HOST_SPI_H_
+#define HOST_SPI_H_
+
+#include <stdint.h>
+
+#define SPI_MODE0 0
+
+class SPISettings {
+public:
+	SPISettings( uint32_t clock, uint8_t bitOrder, uint8_t dataMode ) {}
+};
+
+class HostSPI {
+public:
+	void begin() {}
+	void beginTransaction( SPISettings settings ) {}
+	uint16_t transfer16( uint16_t data );
+};
+extern HostSPI SPI;
+
+#endif /* HOST_SPI_H_ */
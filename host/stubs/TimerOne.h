@@ -0,0 +1,23 @@
+/*
+ * TimerOne.h (host stub)
+ *
+ * The attached interrupt routine is called every 'period' microseconds of virtual time.
+ * Each node (hostNode) has its own, all on the same tick.
+ * PWM duties are recorded in hostPwm[].
+ */
+
+#ifndef HOST_TIMERONE_H_
+#define HOST_TIMERONE_H_
+
+#include <stdint.h>
+
+class HostTimerOne {
+public:
+	void initialize( uint32_t period );
+	void attachInterrupt( void (*isr)() );
+	void pwm( uint8_t pin, uint16_t duty );
+	void setPwmDuty( uint8_t pin, uint16_t duty );
+};
+extern HostTimerOne Timer1;
+
+#endif /* HOST_TIMERONE_H_ */
@@ -0,0 +1,60 @@
+/*
+ * arduino.h (host stub)
+ *
+ * Just enough of the Arduino core to compile plc.cpp on a PC for the tests in host/.
+ * Time is virtual: micros() returns hostMicros, which only moves when the test (or a
+ * stub that models a hardware delay) calls hostAdvance(). See host.h.
+ */
+
+#ifndef HOST_ARDUINO_H_
+#define HOST_ARDUINO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <string>
+
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define LOW 0
+#define HIGH 1
+#define CHANGE 1
+#define MSBFIRST 1
+#define F_CPU 16000000UL
+#define E2END 0x3FF
+#define HOST_NODES 8		// PLC nodes that can run in one process, see host.h
+
+#define _BV(bit) (1 << (bit))
+#define ISR(vector) void vector()
+#define PROGMEM
+inline uint16_t pgm_read_word( const uint16_t *address ) { return *address; }
+
+void pinMode( uint8_t pin, uint8_t mode );
+void digitalWrite( uint8_t pin, uint8_t value );
+int digitalRead( uint8_t pin );
+int analogRead( uint8_t pin );
+void analogWrite( uint8_t pin, int value );
+unsigned long micros();
+void cli();
+void sei();
+inline uint8_t digitalPinToInterrupt( uint8_t pin ) { return pin; }
+void attachInterrupt( uint8_t interrupt, void (*handler)(), int mode );
+
+// Serial output is collected into hostSerial
+extern std::string hostSerial;
+class HostSerial {
+public:
+	void print( const char *s ) { hostSerial += s; }
+	template<typename T> void print( T value ) { hostSerial += std::to_string( +value ); }
+	template<typename T> void println( T value ) { print( value ); println(); }
+	void println() { hostSerial += "\n"; }
+};
+extern HostSerial Serial;
+
+extern volatile uint8_t MCUSR;
+
+// The node whose code is running: selects its TWI registers and Timer1 interrupt
+extern uint8_t hostNode;
+
+#endif /* HOST_ARDUINO_H_ */
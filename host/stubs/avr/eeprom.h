@@ -0,0 +1,18 @@
+/*
+ * avr/eeprom.h (host stub)
+ *
+ * The EEPROM is hostEeprom[]. A byte write keeps the EEPROM busy for HOST_EEPROM_MICROS of
+ * virtual time. Like the real avr-libc routines, reading or writing while busy waits for the
+ * previous write; such waits are counted in hostEepromStalls instead.
+ */
+
+#ifndef HOST_EEPROM_H_
+#define HOST_EEPROM_H_
+
+#include <stdint.h>
+
+bool eeprom_is_ready();
+uint8_t eeprom_read_byte( const uint8_t *address );
+void eeprom_write_byte( uint8_t *address, uint8_t value );
+
+#endif /* HOST_EEPROM_H_ */
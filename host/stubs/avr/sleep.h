@@ -0,0 +1,19 @@
+/*
+ * avr/sleep.h (host stub)
+ *
+ * sleep_cpu() moves virtual time to the next timer tick or scheduled input change.
+ */
+
+#ifndef HOST_SLEEP_H_
+#define HOST_SLEEP_H_
+
+#include <stdint.h>
+
+#define SLEEP_MODE_IDLE 0
+
+inline void set_sleep_mode( uint8_t mode ) {}
+inline void sleep_enable() {}
+inline void sleep_disable() {}
+void sleep_cpu();
+
+#endif /* HOST_SLEEP_H_ */
@@ -0,0 +1,21 @@
+/*
+ * avr/wdt.h (host stub)
+ */
+
+#ifndef HOST_WDT_H_
+#define HOST_WDT_H_
+
+#include <stdint.h>
+
+#define WDTO_15MS 0
+#define WDTO_250MS 4
+#define WDTO_1S 6
+
+extern bool hostWdtEnabled;
+extern uint32_t hostWdtResets;
+
+inline void wdt_enable( uint8_t timeout ) { hostWdtEnabled = true; }
+inline void wdt_disable() { hostWdtEnabled = false; }
+inline void wdt_reset() { hostWdtResets++; }
+
+#endif /* HOST_WDT_H_ */
@@ -0,0 +1,48 @@
+/*
+ * util/twi.h (host stub)
+ *
+ * The TWI registers are plain variables, one set per node (hostNode selects it). Either the test
+ * plays the hardware: it sets TWSR (and TWDR) and calls TWI_vect() to run the interrupt handler.
+ * Or the nodes are attached to the simulated bus with hostBusAttach(), see host.h.
+ */
+
+#ifndef HOST_TWI_H_
+#define HOST_TWI_H_
+
+#include <arduino.h>
+
+#define TWINT 7
+#define TWEA 6
+#define TWSTA 5
+#define TWSTO 4
+#define TWEN 2
+#define TWIE 0
+#define TWGCE 0
+
+#define TW_STATUS (TWSR & 0xF8)
+#define TW_START 0x08
+#define TW_REP_START 0x10
+#define TW_MT_SLA_ACK 0x18
+#define TW_MT_SLA_NACK 0x20
+#define TW_MT_DATA_ACK 0x28
+#define TW_MT_DATA_NACK 0x30
+#define TW_MT_ARB_LOST 0x38
+#define TW_SR_GCALL_ACK 0x70
+#define TW_SR_ARB_LOST_GCALL_ACK 0x78
+#define TW_SR_GCALL_DATA_ACK 0x90
+#define TW_SR_STOP 0xA0
+#define TW_BUS_ERROR 0x00
+
+struct HostTwi {
+	volatile uint8_t twbr, twsr, twcr, twdr, twar;
+};
+extern HostTwi hostTwi[HOST_NODES];
+
+#define TWBR (hostTwi[hostNode].twbr)
+#define TWSR (hostTwi[hostNode].twsr)
+#define TWCR (hostTwi[hostNode].twcr)
+#define TWDR (hostTwi[hostNode].twdr)
+#define TWAR (hostTwi[hostNode].twar)
+void TWI_vect();
+
+#endif /* HOST_TWI_H_ */
@@ -0,0 +1,71 @@
+/*
+ * test_eventscan.cpp
+ *
+ * Input to output reaction time of the free running scan (CList.execute() in loop()) and of
+ * EVENT_SCAN (CList.run()), measured in virtual time for a short and a long scan.
+ * Built with -DEVENT_SCAN, see the Makefile.
+ */
+
+#include "host.h"
+
+#define CHANGES 500
+
+struct Reaction {
+	uint32_t min, max, sum;
+};
+
+static uint32_t seed = 1;
+
+// Small deterministic pseudo random numbers for the moments of the input changes
+static uint32_t random( uint32_t range ) {
+	seed = seed * 1103515245UL + 12345;
+	return ( seed >> 8 ) % range;
+}
+
+// Toggle input 0 CHANGES times at random moments and time until output 16 follows
+static Reaction react( bool event, uint32_t load ) {
+Reaction r = { UINT32_MAX, 0, 0 };
+uint32_t cnt, at, took;
+uint16_t want;
+	hostReset();
+	CList.begin();
+	new Not( 0, 16 );
+	new HostLoad( load );
+	while ( hostMicros < 10000 ) event ? CList.run() : CList.execute();
+	for ( cnt = 0; cnt < CHANGES; cnt++ ) {
+		at = hostMicros + 2 * load + random( 5000 );
+		hostSetInputs( ~cnt & 1, at );
+		want = cnt & 1;
+		while ( hostMicros < at || ( hostOutputs & 1 ) != want ) event ? CList.run() : CList.execute();
+		took = hostOutputTime - at;
+		if ( took < r.min ) r.min = took;
+		if ( took > r.max ) r.max = took;
+		r.sum += took;
+	}
+	return r;
+}
+
+static void compare( uint32_t load ) {
+Reaction free, event;
+	free = react( false, load );
+	event = react( true, load );
+	printf( "eventscan: scan %lu us: free running %lu/%lu/%lu us, EVENT_SCAN %lu/%lu/%lu us (min/mean/max)\n",
+		(unsigned long)( load + HOST_SPI_MICROS ),
+		(unsigned long)free.min, (unsigned long)( free.sum / CHANGES ), (unsigned long)free.max,
+		(unsigned long)event.min, (unsigned long)( event.sum / CHANGES ), (unsigned long)event.max );
+	// free running: the rest of the scan in progress, a scan to solve and the transfer that starts the next
+	CHECK( free.max <= 2 * ( load + HOST_SPI_MICROS ) );
+	CHECK( free.min >= load + HOST_SPI_MICROS );
+	// event: latch, solve and output in one pass, after the rest of the scan in progress if there is one
+	CHECK( event.min >= load + HOST_SPI_MICROS );
+	CHECK( event.max <= 2 * load + 3 * HOST_SPI_MICROS );
+	// a scan that fits in a tick leaves the processor idle, and an idle processor reacts in one scan
+	if ( load + 2 * HOST_SPI_MICROS < TIMERTICK ) CHECK( event.sum < free.sum * 9 / 10 );
+}
+
+int main() {
+	compare( 200 );				// scans idle most of the tick in EVENT_SCAN
+	compare( 2000 );			// longer than a tick, EVENT_SCAN scans back to back
+	printf( "eventscan: %s\n", hostFailures ? "FAILED" : "ok" );
+	return hostFailures ? 1 : 0;
+}
@@ -0,0 +1,146 @@
+/*
+ * test_functionblock.cpp
+ *
+ * A FunctionBlock with an instance per conveyor lane must behave exactly like the same lane
+ * unrolled (see lanes.h), and never write its input parameters. Also prints the RAM both take on the
+ * ATmega32U4 and checks that instances beyond MAXTIMERS are refused.
+ * The scan time comparison is in the benchmark (lanes.*). Built with bench_ladder.h, see the Makefile.
+ */
+
+#include <vector>
+#include "lanes.h"
+
+#define SCANS 40000
+#define SCAN_MICROS 500
+
+typedef uint16_t (Component::*SizeMethod)();
+
+// Reaches the protected Component::frameSize() of any component
+struct Frame: public Component {
+	static SizeMethod method() { return &Frame::frameSize; }
+};
+
+static uint32_t seed;
+static uint32_t motorScans, counted;			// activity of the last run, so that the comparison is not vacuous
+
+static uint32_t random( uint32_t range ) {
+	seed = seed * 1103515245UL + 12345;
+	return ( seed >> 8 ) % range;
+}
+
+// Items pass the sensors except in the idle phases, which are long enough for a jam.
+// Start and stop are pulses now and then.
+static void stimulus( uint32_t scan ) {
+uint8_t k;
+LaneMap m;
+	for ( k = 0; k < LANES; k++ ) {
+		m = laneMap( k );
+		setBit( m.param[0], random( 300 ) == 0 );
+		setBit( m.param[1], random( 1000 ) == 0 );
+		if ( ( scan / 1500 + k ) % 3 && random( 20 ) == 0 ) setBit( m.param[2], !Bit( m.param[2] ) );
+	}
+}
+
+// Run the lanes and record the outputs and counts after every scan
+static std::vector<uint8_t> run( bool block, uint32_t *jams ) {
+std::vector<uint8_t> trace;
+uint32_t scan;
+uint8_t k, inputs[3];
+	hostReset();
+	CList.begin();
+	seed = 1;
+	if ( block ) lanesBlock();
+	else lanesUnrolled();
+	new HostLoad( SCAN_MICROS - HOST_SPI_MICROS );
+	*jams = 0;
+	motorScans = 0;
+	counted = 0;
+	for ( scan = 0; scan < SCANS; scan++ ) {
+		stimulus( scan );
+		memcpy( inputs, &bits[4], sizeof(inputs) );
+		CList.execute();
+		CHECK( memcmp( inputs, &bits[4], sizeof(inputs) ) == 0 );		// the input parameters are only read
+		trace.push_back( bits[7] );
+		trace.push_back( bits[8] );
+		for ( k = 0; k < LANES; k++ ) {
+			trace.push_back( ints[16 + k] & 0xff );
+			trace.push_back( ints[16 + k] >> 8 );
+			counted += ints[16 + k];
+		}
+		if ( bits[7] ) motorScans++;
+		if ( bits[8] ) (*jams)++;
+	}
+	return trace;
+}
+
+// Object sizes with avr-gcc for the ATmega32U4: 2 byte pointers and enums, no padding, 1 byte logicBit
+// (BITSPACE <= 32) and numeric. Component: vtable pointer 2, inBit and outBit 2, state 2, prevInput 1.
+// Every 'new' also costs 2 bytes of heap bookkeeping.
+#define AVR_POINTER 2
+#define AVR_HEAP 2
+#define AVR_COMPONENT 7
+#define AVR_NOT AVR_COMPONENT
+#define AVR_BISTABLE ( AVR_COMPONENT + 1 )
+#define AVR_LOGIC2 ( AVR_COMPONENT + 1 + 2 )
+#define AVR_MONOSTABLE ( AVR_COMPONENT + 4 + 1 )
+#define AVR_UPCOUNTER ( AVR_COMPONENT + 1 + 1 )
+#define AVR_DELAY ( AVR_COMPONENT + 1 + 4 + 4 + 1 )
+#define AVR_FUNCTIONBLOCK ( AVR_COMPONENT + 13 + 2 + 2 * AVR_POINTER )	// 13 byte members, frameBytes, body and frames
+
+static void ram() {
+FunctionBlock *fb;
+uint8_t timers;
+uint16_t frames;
+uint32_t body, unrolled, block;
+	body = 2 * AVR_BISTABLE + 3 * AVR_LOGIC2 + 2 * AVR_NOT + AVR_MONOSTABLE + AVR_UPCOUNTER + AVR_DELAY + 10 * AVR_HEAP;
+	hostReset();
+	CList.begin();
+	lanesUnrolled();
+	timers = timerCount / LANES;
+	// components, their list slots, timers and the local bits in the bit space
+	unrolled = LANES * ( body + 10 * AVR_POINTER + timers * sizeof(uint32_t) + LANE_BITS / 8 );
+	hostReset();
+	CList.begin();
+	fb = lanesBlock();
+	CHECK( timerCount == LANES * timers );				// the first lane runs on the timers of the body
+	frames = (fb->*Frame::method())();					// the same on the PC and the AVR
+	// the body once, the block, its list slot and body array, the frames, the window and the timers
+	block = body + AVR_FUNCTIONBLOCK + AVR_HEAP + 11 * AVR_POINTER + AVR_HEAP + frames + AVR_HEAP
+		+ LANES * timers * sizeof(uint32_t) + LANE_BITS / 8 + sizeof(uint16_t);
+	printf( "functionblock: %d lanes of 10 components on the ATmega32U4: unrolled %lu bytes, FunctionBlock %lu bytes (frame %u bytes per lane)\n",
+		LANES, (unsigned long)unrolled, (unsigned long)block, frames / LANES );
+	CHECK( block < unrolled );
+}
+
+// An instance that would need more timers than MAXTIMERS has left is refused and takes none
+static void timersOut() {
+FunctionBlock *fb;
+logicBit bindings[2] = { 32, 33 };
+uint8_t n = 1;
+	hostReset();
+	CList.begin();
+	fb = new FunctionBlock( 10, 1, 1, 1, 8, 1, 0, 0, 255 );
+	fb->define();
+	new Monostable( 80, 81, 100 );
+	new Monostable( 81, 82, 100 );
+	fb->endDefine();
+	CHECK( fb->instance( bindings, NULL ) );
+	while ( fb->instance( bindings, NULL ) ) n++;
+	CHECK( n == MAXTIMERS / 2 );
+	CHECK( timerCount == MAXTIMERS );
+}
+
+int main() {
+std::vector<uint8_t> unrolled, block;
+uint32_t jams, blockJams;
+	unrolled = run( false, &jams );
+	block = run( true, &blockJams );
+	CHECK( jams > 0 && jams < SCANS );
+	CHECK( motorScans > 0 && counted > 0 );
+	CHECK( blockJams == jams );
+	CHECK( unrolled == block );
+	ram();
+	timersOut();
+	printf( "functionblock: %s\n", hostFailures ? "FAILED" : "ok" );
+	return hostFailures ? 1 : 0;
+}
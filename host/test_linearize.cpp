@@ -0,0 +1,110 @@
+/*
+ * test_linearize.cpp
+ *
+ * Linearize at the ends of the table, on the breakpoints and inside increasing, decreasing,
+ * flat and full range segments, a table of more than 128 points, and the table generator
+ * of lintable.h on a thermistor curve.
+ */
+
+#include "lintable.h"
+
+// Ends below and above the table, a rising, a falling, a flat and an almost full range segment
+static const uint16_t shapes[] PROGMEM = { 100, 1000,  200, 3000,  400, 2000,  1000, 2000,  60000, 65535 };
+static uint16_t big[400];
+
+static void ladder( const uint16_t *table, uint8_t points ) {
+	hostReset();
+	CList.begin();
+	new Linearize( 0, 1, table, points );
+}
+
+static uint16_t eval( uint16_t x ) {
+	ints[0] = x;
+	CList.execute();
+	return ints[1];
+}
+
+// The exact interpolation, rounded towards y0 as Linearize does
+static double reference( const uint16_t *table, uint8_t points, uint16_t x ) {
+uint8_t n;
+double x0, x1, y0, y1;
+	if ( x <= table[0] ) return table[1];
+	if ( x >= table[2 * ( points - 1 )] ) return table[2 * points - 1];
+	for ( n = 1; x >= table[2 * n]; n++ ) ;
+	x0 = table[2 * n - 2];
+	x1 = table[2 * n];
+	y0 = table[2 * n - 1];
+	y1 = table[2 * n + 1];
+	return y1 >= y0 ? y0 + floor( ( y1 - y0 ) * ( x - x0 ) / ( x1 - x0 ) ) : y0 - floor( ( y0 - y1 ) * ( x - x0 ) / ( x1 - x0 ) );
+}
+
+static void segments() {
+uint32_t x, wrong = 0;
+	ladder( shapes, 5 );
+	CHECK( eval( 0 ) == 1000 );
+	CHECK( eval( 100 ) == 1000 );
+	CHECK( eval( 60000 ) == 65535 );
+	CHECK( eval( 65535 ) == 65535 );
+	CHECK( eval( 200 ) == 3000 );
+	CHECK( eval( 400 ) == 2000 );
+	CHECK( eval( 1000 ) == 2000 );
+	CHECK( eval( 150 ) == 2000 );				// rising
+	CHECK( eval( 101 ) == 1020 );
+	CHECK( eval( 300 ) == 2500 );				// falling
+	CHECK( eval( 399 ) == 2005 );
+	CHECK( eval( 700 ) == 2000 );				// flat
+	CHECK( eval( 59999 ) == 65533 );			// (65535 - 2000) * 58999 needs all 32 bits
+	for ( x = 0; x <= 65535; x++ ) {
+		if ( eval( x ) != reference( shapes, 5, x ) ) wrong++;
+	}
+	CHECK( wrong == 0 );
+}
+
+// 200 points: the table indexes go past 255
+static void bigTable() {
+uint16_t cnt;
+	for ( cnt = 0; cnt < 200; cnt++ ) {
+		big[2 * cnt] = cnt * 300;
+		big[2 * cnt + 1] = cnt % 2 ? 5000 : cnt * 100;
+	}
+	ladder( big, 200 );
+	for ( cnt = 0; cnt < 200; cnt++ ) CHECK( eval( cnt * 300 ) == big[2 * cnt + 1] );
+	CHECK( eval( 199 * 300 + 1 ) == big[399] );
+	CHECK( eval( 198 * 300 + 150 ) == reference( big, 200, 198 * 300 + 150 ) );
+}
+
+// The generator on a 10k NTC (B 3950) under a 10k resistor, 10 bit ADC to 0.1 degC + 50 degC
+static void generator() {
+std::vector<CurvePoint> curve;
+std::vector<uint16_t> table16, table32;
+LintableError e16, e32;
+uint16_t a;
+double r;
+size_t cnt;
+	for ( a = 20; a <= 1000; a++ ) {
+		r = 10000.0 * a / ( 1023 - a );
+		curve.push_back( CurvePoint{ a, ( 1 / ( 1 / 298.15 + log( r / 10000 ) / 3950 ) - 273.15 + 50 ) * 10 } );
+	}
+	table16 = lintableFit( curve, 16 );
+	table32 = lintableFit( curve, 32 );
+	CHECK( table16.size() <= 2 * 16 && table32.size() <= 2 * 32 );
+	CHECK( table16[0] == 20 && table16[table16.size() - 2] == 1000 );
+	for ( cnt = 2; cnt < table16.size(); cnt += 2 ) CHECK( table16[cnt] > table16[cnt - 2] );
+	e16 = lintableError( curve, table16 );
+	e32 = lintableError( curve, table32 );
+	printf( "linearize: NTC curve, 981 samples: 16 points max error %.2f mean %.2f, 32 points max error %.2f mean %.2f (0.1 degC)\n",
+		e16.max, e16.mean, e32.max, e32.mean );
+	CHECK( e16.max < 6 );
+	CHECK( e32.max < e16.max );
+	// the reported error is what the component really gives
+	ladder( table16.data(), table16.size() / 2 );
+	CHECK( fabs( eval( e16.maxAt ) - curve[e16.maxAt - 20].y ) == e16.max );
+}
+
+int main() {
+	segments();
+	bigTable();
+	generator();
+	printf( "linearize: %s\n", hostFailures ? "FAILED" : "ok" );
+	return hostFailures ? 1 : 0;
+}
@@ -0,0 +1,189 @@
+/*
+ * test_link.cpp
+ *
+ * I2CLINK of one node against a bus played by the test: the test sets TWSR (and TWDR) the way the
+ * TWI hardware would and calls the TWI_vect() handler, for our own messages and for those of the
+ * other nodes. Covers a published range of more than 255 bytes, a message acknowledged by the bus
+ * but lost at a receiver while other bytes keep changing, a message nobody acknowledges, and received
+ * messages: sequence gaps, a full receive queue, rejected addresses and out of range node numbers.
+ * After each message that gets through the node keeps quiet for a while (see plc.cpp); the scans wait it out.
+ * Built with -DI2CLINK and link_ladder.h, see the Makefile.
+ */
+
+#include <vector>
+#include <util/twi.h>
+#include "host.h"
+
+#define NODE 1
+#define BIT_FIRST 64				// bit bytes 8 ... 11
+#define BIT_LAST 95
+#define INT_FIRST 10				// 150 numerics, 300 bytes
+#define INT_LAST 159
+#define SIZE ( ( BIT_LAST - BIT_FIRST + 1 ) / 8 + 2 * ( INT_LAST - INT_FIRST + 1 ) )
+// Ticks a node keeps quiet after a full message, see plc.cpp
+#define QUIET ( ( ( LINK_NODES - 1 ) * ( 4 + LINK_FRAME + 1 ) * 9UL * 1000000UL / LINK_CLOCK + TIMERTICK - 1 ) / TIMERTICK )
+
+static uint8_t seen[BITSPACE + 2 * INTSPACE];	// the published bytes as a receiver got them
+static uint8_t nextSeq;
+
+static uint16_t intAddress( numeric n ) { return BITSPACE + 2 * n; }
+
+// Play the bus for our pending message, if any. 'ack' false = nobody acknowledges the general call
+static std::vector<uint8_t> busSend( bool ack = true ) {
+std::vector<uint8_t> msg;
+	if ( !( TWCR & _BV(TWSTA) ) ) return msg;
+	TWSR = TW_START;
+	TWI_vect();
+	CHECK( TWDR == 0x00 );						// general call, write
+	TWSR = ack ? TW_MT_SLA_ACK : TW_MT_SLA_NACK;
+	TWI_vect();
+	while ( ack && !( TWCR & _BV(TWSTO) ) ) {
+		msg.push_back( (uint8_t)TWDR );
+		TWSR = TW_MT_DATA_ACK;
+		TWI_vect();
+	}
+	return msg;
+}
+
+// A message from another node arrives
+static void busReceive( uint8_t node, uint8_t seq, uint16_t address, const uint8_t *data, uint8_t len ) {
+uint8_t cnt, header[4] = { node, seq, (uint8_t)( address & 0xff ), (uint8_t)( address >> 8 ) };
+	TWSR = TW_SR_GCALL_ACK;
+	TWI_vect();
+	for ( cnt = 0; cnt < 4 + len; cnt++ ) {
+		TWDR = cnt < 4 ? header[cnt] : data[cnt - 4];
+		TWSR = TW_SR_GCALL_DATA_ACK;
+		TWI_vect();
+	}
+	TWSR = TW_SR_STOP;
+	TWI_vect();
+}
+
+// Check the framing of one of our messages and, unless it is lost, apply it to 'seen'
+static void deliver( const std::vector<uint8_t> &msg, bool lost = false ) {
+uint16_t address, len;
+	CHECK( msg.size() > 4 && msg.size() <= 4 + LINK_FRAME );
+	CHECK( msg[0] == NODE );
+	CHECK( msg[1] == nextSeq );
+	nextSeq = msg[1] + 1;
+	address = msg[2] | ( msg[3] << 8 );
+	len = msg.size() - 4;
+	if ( address < BITSPACE ) CHECK( address >= BIT_FIRST / 8 && address + len <= BIT_LAST / 8 + 1 );
+	else {
+		CHECK( address >= intAddress( INT_FIRST ) && address + len <= intAddress( INT_LAST + 1 ) );
+		CHECK( ( address - BITSPACE ) % 2 == 0 && len % 2 == 0 );		// whole numerics only
+	}
+	if ( !lost ) memcpy( seen + address, msg.data() + 4, len );
+}
+
+static bool allSeen() {
+	return memcmp( seen + BIT_FIRST / 8, &bits[BIT_FIRST / 8], ( BIT_LAST - BIT_FIRST + 1 ) / 8 ) == 0 &&
+		memcmp( seen + intAddress( INT_FIRST ), &ints[INT_FIRST], 2 * ( INT_LAST - INT_FIRST + 1 ) ) == 0;
+}
+
+// One scan of about a tick, delivering what we send
+static void scan() {
+std::vector<uint8_t> msg;
+	CList.execute();
+	msg = busSend();
+	if ( msg.size() ) deliver( msg );
+}
+
+// Scan until we have a message to send, after the quiet time of the last one
+static void waitTurn() {
+uint16_t cnt;
+	for ( cnt = 0; cnt <= QUIET && !( TWCR & _BV(TWSTA) ); cnt++ ) CList.execute();
+}
+
+// Everything is sent once after linkBegin(), across the 255 byte mark
+static void begin() {
+uint16_t cnt;
+	for ( cnt = BIT_FIRST / 8; cnt <= BIT_LAST / 8; cnt++ ) bits[cnt] = cnt * 37;
+	for ( cnt = INT_FIRST; cnt <= INT_LAST; cnt++ ) ints[cnt] = cnt * 257 + 3;
+	CList.execute();
+	CHECK( busSend().empty() );					// nothing before linkBegin()
+	CList.linkBegin( NODE, BIT_FIRST, BIT_LAST, INT_FIRST, INT_LAST );
+	for ( cnt = 0; cnt < 2 * ( SIZE / LINK_FRAME + 2 ) * ( QUIET + 1 ) && !allSeen(); cnt++ ) scan();	// refreshes take some turns
+	CHECK( allSeen() );
+}
+
+// A message the bus acknowledged but a receiver lost (its queue was full) while another
+// published byte changes on every scan: the refresh brings the lost value in time
+static void lost() {
+std::vector<uint8_t> msg;
+uint32_t start, bound;
+	ints[100] = 0x1234;
+	waitTurn();
+	msg = busSend();
+	deliver( msg, true );
+	CHECK( ( msg[2] | ( msg[3] << 8 ) ) == intAddress( 100 ) );
+	start = tickCount;
+	bound = ( LINK_REFRESH + QUIET ) * ( ( SIZE + LINK_FRAME - 1 ) / LINK_FRAME + 1 );
+	while ( !allSeen() && tickCount - start <= bound ) {
+		bits[8]++;
+		scan();
+	}
+	printf( "link: %d published bytes, a lost value was resent after %lu ticks while other bytes kept changing (bound %lu)\n",
+		SIZE, (unsigned long)( tickCount - start ), (unsigned long)bound );
+	CHECK( allSeen() );
+}
+
+// Nobody acknowledges: counted and sent again
+static void nack() {
+std::vector<uint8_t> msg;
+uint16_t errors;
+	errors = CList.linkTxErrors();
+	ints[150] = 0x4321;
+	waitTurn();
+	CHECK( busSend( false ).empty() );
+	nextSeq++;									// that sequence number is gone
+	CHECK( CList.linkTxErrors() == errors + 1 );
+	CList.execute();
+	msg = busSend();
+	deliver( msg );
+	CHECK( ( msg[2] | ( msg[3] << 8 ) ) == intAddress( 150 ) );
+	CHECK( allSeen() );
+}
+
+// Messages of the other nodes
+static void receive() {
+uint8_t data[4] = { 0x11, 0x22, 0x33, 0x44 };
+uint8_t seq;
+	busReceive( 2, 0, intAddress( 170 ), data, 4 );
+	scan();
+	CHECK( ints[170] == 0x2211 && ints[171] == 0x4433 );
+	CHECK( CList.linkAge( 2 ) <= 1 );
+	CHECK( CList.linkErrors( 2 ) == 0 );
+	busReceive( 2, 2, intAddress( 170 ), data, 2 );		// sequence 1 was lost
+	scan();
+	CHECK( CList.linkErrors( 2 ) == 1 );
+	busReceive( 2, 3, 0, data, 2 );						// the inputs are never written
+	scan();
+	CHECK( CList.linkErrors( 2 ) == 2 );
+	// a full queue drops the message, which shows as a gap afterwards
+	for ( seq = 4; seq < 9; seq++ ) busReceive( 2, seq, intAddress( 172 ), data, 2 );
+	scan();
+	busReceive( 2, 9, intAddress( 172 ), data, 2 );
+	scan();
+	CHECK( CList.linkErrors( 2 ) > 2 );
+	// node numbers beyond LINK_NODES are ignored and cannot index the tables
+	busReceive( LINK_NODES + 3, 0, intAddress( 174 ), data, 2 );
+	scan();
+	CHECK( ints[174] == 0 );
+	CHECK( CList.linkAge( LINK_NODES ) == UINT32_MAX );
+	CHECK( CList.linkAge( 200 ) == UINT32_MAX );
+	CHECK( CList.linkErrors( 200 ) == 0 );
+	CHECK( CList.linkAge( 3 ) == UINT32_MAX );			// never heard of
+}
+
+int main() {
+	hostReset();
+	CList.begin();
+	new HostLoad( TIMERTICK - HOST_SPI_MICROS );
+	begin();
+	lost();
+	nack();
+	receive();
+	printf( "link: %s\n", hostFailures ? "FAILED" : "ok" );
+	return hostFailures ? 1 : 0;
+}
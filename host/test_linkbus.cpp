@@ -0,0 +1,197 @@
+/*
+ * test_linkbus.cpp
+ *
+ * I2CLINK between several complete PLC nodes on the simulated I2C bus of host.h (each node is plc.cpp
+ * in a namespace of its own, see linknode.cpp and linkbus.h). Covers two nodes starting a message at
+ * the same moment: the lower node number wins arbitration, the other node sends after it but has
+ * missed the winner's message, notices the gap and gets the value with a refresh. Then a message lost
+ * at one node only, and finally 2 ... 8 nodes publishing a clock that changes every tick, more than the
+ * bus can carry: every node must still see every other one, with the clock of each no staler than
+ * STALE_BOUND. The lower node always wins arbitration, so without the quiet time after each message
+ * the higher nodes would never get the bus at all.
+ *
+ *   test_linkbus            run the test
+ *   test_linkbus --report   print "linkbus.N,bytes_per_s,worst_staleness_ms" for N = 2 ... 8 (make bench)
+ *
+ * Built with -DI2CLINK -DLINK_NODES=8 and link_ladder.h, see the Makefile.
+ */
+
+#include <string.h>
+#include "host.h"
+#include "linkbus.h"
+
+LinkNode linkNodes[HOST_NODES];
+
+// Published by node k: bit byte BYTE(k) and numerics INT(k) ... INT(k) + PUBLISHED - 1, the first the clock
+#define BYTE(k) ( 8 + ( k ) )
+#define INT(k) ( 16 + 8 * ( k ) )
+#define PUBLISHED 8
+#define SCAN_MICROS 1000
+#define SETTLE_MICROS 1000000
+#define RUN_MICROS 10000000
+#define STALE_BOUND 250					// ms, no node kept off the bus (see the quiet time in plc.cpp)
+#define PUBLISHED_BYTES ( 1 + 2 * PUBLISHED )
+// Ticks a node keeps quiet after a full message, see plc.cpp
+#define QUIET ( ( ( LINK_NODES - 1 ) * ( 4 + LINK_FRAME + 1 ) * 9UL * 1000000UL / LINK_CLOCK + TIMERTICK - 1 ) / TIMERTICK )
+#define REFRESH_BOUND ( ( LINK_REFRESH + QUIET ) * ( ( PUBLISHED_BYTES + LINK_FRAME - 1 ) / LINK_FRAME ) + 2 )	// ms
+
+static uint8_t nodes;
+
+// Power on 'n' nodes, attach them to the bus and start the link
+static void powerOn( uint8_t n ) {
+uint8_t k;
+	hostReset();
+	nodes = n;
+	for ( k = 0; k < n; k++ ) {
+		hostNode = k;
+		linkNodes[k].powerOn();
+		linkNodes[k].linkBegin( k, BYTE(k) * 8, BYTE(k) * 8 + 7, INT(k), INT(k) + PUBLISHED - 1 );
+		hostBusAttach( k, linkNodes[k].twi );
+	}
+	hostNode = 0;
+}
+
+// One scan of every node, then the rest of SCAN_MICROS
+static void scan() {
+uint8_t k;
+	for ( k = 0; k < nodes; k++ ) {
+		hostNode = k;
+		linkNodes[k].execute();
+	}
+	hostNode = 0;
+	hostAdvance( SCAN_MICROS );
+}
+
+static uint16_t now() { return hostMicros / 1000; }
+
+// Every node sets its clock and now and then its other values, as a ladder would
+static void publish() {
+uint8_t k, cnt;
+	for ( k = 0; k < nodes; k++ ) {
+		linkNodes[k].ints[INT(k)] = now();
+		if ( now() % 100 == k ) {
+			for ( cnt = 1; cnt < PUBLISHED; cnt++ ) linkNodes[k].ints[INT(k) + cnt]++;
+			linkNodes[k].bits[BYTE(k)]++;
+		}
+	}
+}
+
+// How stale node j's copy of node k's clock is, in ms
+static uint16_t staleness( uint8_t j, uint8_t k ) { return now() - linkNodes[j].ints[INT(k)]; }
+
+// Scan until no node is sending or keeping quiet
+static void ready() {
+uint8_t k;
+	for ( k = 0; k < nodes; k++ ) {
+		if ( !linkNodes[k].linkReady() ) break;
+	}
+	if ( k < nodes ) {
+		scan();
+		ready();
+	}
+}
+
+// Scan node 'k' alone
+static void scanNode( uint8_t k ) {
+	hostNode = k;
+	linkNodes[k].execute();
+	hostNode = 0;
+}
+
+// Nodes 0 and 1 wait for the bus while node 2 sends and start together when it is free
+static void arbitration() {
+uint32_t lost, start;
+uint16_t errors, value0, value1;
+	powerOn( 3 );
+	while ( hostMicros < SETTLE_MICROS ) scan();
+	ready();
+	lost = hostBusArbLost;
+	errors = linkNodes[1].linkErrors( 0 );
+	value0 = ++linkNodes[0].ints[INT(0) + 1];
+	value1 = ++linkNodes[1].ints[INT(1) + 1];
+	linkNodes[2].ints[INT(2) + 1]++;
+	start = hostMicros;
+	scanNode( 2 );
+	scanNode( 0 );
+	scanNode( 1 );
+	while ( ( linkNodes[1].ints[INT(0) + 1] != value0 || linkNodes[0].ints[INT(1) + 1] != value1 ) && hostMicros - start < REFRESH_BOUND * 1000 ) scan();
+	CHECK( hostBusArbLost == lost + 1 );					// node 1 lost to node 0
+	CHECK( linkNodes[1].ints[INT(0) + 1] == value0 );		// missed the winner's message but got the
+	CHECK( linkNodes[1].linkErrors( 0 ) == errors + 1 );	// value with a later one, and noticed the gap
+	CHECK( linkNodes[0].ints[INT(1) + 1] == value1 );		// and sent its own message after it
+	CHECK( linkNodes[0].linkErrors( 1 ) == 0 );
+	CHECK( linkNodes[2].linkErrors( 0 ) == 0 && linkNodes[2].linkErrors( 1 ) == 0 );
+	printf( "linkbus: node 1 lost arbitration to node 0, got its value again after %u ms (bound %u)\n",
+		(unsigned)( ( hostMicros - start ) / 1000 ), (unsigned)REFRESH_BOUND );
+}
+
+// A message lost at one node only
+static void loss() {
+uint32_t start;
+uint16_t errors, value;
+	powerOn( 3 );
+	while ( hostMicros < SETTLE_MICROS ) scan();
+	ready();
+	errors = linkNodes[2].linkErrors( 0 );
+	hostBusDeaf( 2, 1 );
+	value = ++linkNodes[0].ints[INT(0) + 1];
+	start = hostMicros;
+	scanNode( 0 );
+	hostAdvance( SCAN_MICROS );
+	scan();
+	CHECK( linkNodes[1].ints[INT(0) + 1] == value );
+	CHECK( linkNodes[2].ints[INT(0) + 1] != value );
+	while ( linkNodes[2].ints[INT(0) + 1] != value && hostMicros - start < REFRESH_BOUND * 1000 ) scan();
+	CHECK( linkNodes[2].ints[INT(0) + 1] == value );
+	CHECK( linkNodes[2].linkErrors( 0 ) == errors + 1 );
+	CHECK( linkNodes[1].linkErrors( 0 ) == 0 );
+	printf( "linkbus: a message lost at node 2 was made good after %u ms (bound %u)\n",
+		(unsigned)( ( hostMicros - start ) / 1000 ), (unsigned)REFRESH_BOUND );
+}
+
+// 'n' nodes publishing for RUN_MICROS after SETTLE_MICROS. Returns the acknowledged bytes a second,
+// the worst staleness of any clock at any node in 'worst' (ms)
+static uint32_t traffic( uint8_t n, uint16_t &worst ) {
+uint32_t bytes;
+uint8_t j, k;
+	powerOn( n );
+	worst = 0;
+	while ( hostMicros < SETTLE_MICROS ) {
+		publish();
+		scan();
+	}
+	bytes = hostBusBytes;
+	while ( hostMicros < SETTLE_MICROS + RUN_MICROS ) {
+		publish();
+		scan();
+		for ( j = 0; j < n; j++ ) {
+			for ( k = 0; k < n; k++ ) {
+				if ( j != k && staleness( j, k ) > worst ) worst = staleness( j, k );
+			}
+		}
+	}
+	return (uint64_t)( hostBusBytes - bytes ) * 1000000 / RUN_MICROS;
+}
+
+int main( int argc, char **argv ) {
+uint16_t worst;
+uint32_t rate;
+uint8_t n;
+	if ( argc > 1 && !strcmp( argv[1], "--report" ) ) {
+		for ( n = 2; n <= HOST_NODES; n++ ) {
+			rate = traffic( n, worst );
+			printf( "linkbus.%u,%u,%u\n", n, (unsigned)rate, worst );
+		}
+		return hostFailures ? 1 : 0;
+	}
+	arbitration();
+	loss();
+	for ( n = 2; n <= HOST_NODES; n++ ) {
+		rate = traffic( n, worst );
+		CHECK( worst <= STALE_BOUND );
+		printf( "linkbus: %u nodes, %u bytes/s on the bus, worst staleness %u ms, bus busy %u%%\n",
+			n, (unsigned)rate, worst, (unsigned)( (uint64_t)hostBusBusyMicros * 100 / hostMicros ) );
+	}
+	printf( "linkbus: %s\n", hostFailures ? "FAILED" : "ok" );
+	return hostFailures ? 1 : 0;
+}
@@ -0,0 +1,124 @@
+/*
+ * test_pid.cpp
+ *
+ * PID loop response against a simulated first order plant, anti-windup, enable/disable and
+ * the evaluation period with scans that do not divide the period. The cost of an evaluation
+ * is in the benchmark (PID, PID.wait).
+ */
+
+#include "host.h"
+
+#define SCAN_MICROS 700
+#define LONG_SCAN_MICROS 2300		// over two ticks and not a divisor of the period
+#define PERIOD 10					// ticks between PID evaluations
+
+// In 0 = set point, 1 = process value, 2 = output. Bit 32 = enable
+static PID *pid;
+
+static void ladder( float kp, float ki, float kd, uint16_t outMax, uint32_t scanMicros = SCAN_MICROS ) {
+	hostReset();
+	CList.begin();
+	pid = new PID( 32, 0, 1, 2, kp, ki, kd, PERIOD, 0, outMax );
+	new HostLoad( scanMicros - HOST_SPI_MICROS );
+}
+
+// First order plant: the process value approaches the output with a 200 ms time constant,
+// but no further than 'limit'. Run for 'micros' and return the largest process value seen.
+static double plant, limit;
+
+static uint16_t run( uint32_t micros ) {
+uint32_t until, last;
+uint16_t peak = 0;
+	until = hostMicros + micros;
+	while ( hostMicros < until ) {
+		last = hostMicros;
+		CList.execute();
+		plant += ( ints[2] - plant ) * ( hostMicros - last ) / 200000.0;
+		if ( plant > limit ) plant = limit;
+		ints[1] = plant + 0.5;
+		if ( ints[1] > peak ) peak = ints[1];
+	}
+	return peak;
+}
+
+// A step of the set point settles without steady state error
+static void step() {
+uint16_t peak;
+	ladder( 0.5, 0.05, 2.0, 4000 );
+	plant = 0;
+	limit = 1e9;
+	ints[0] = 2000;
+	setBit( 32, true );
+	peak = run( 3000000 );
+	CHECK( ints[1] >= 1990 && ints[1] <= 2010 );
+	peak = run( 1000000 );
+	printf( "pid: step 0 -> 2000: %u after 3 s, %u after 4 s, overshoot %u\n", (unsigned)plant, ints[1], peak > 2000 ? peak - 2000 : 0 );
+	CHECK( ints[1] >= 1998 && ints[1] <= 2002 );
+	CHECK( peak <= 2100 );
+}
+
+// A process value that cannot reach the set point does not wind the integral up beyond the output limit:
+// when the set point comes down, the output leaves the limit on the next evaluation
+static void windup() {
+	ladder( 0.5, 0.5, 0.0, 3000 );
+	plant = 0;
+	limit = 1000;
+	ints[0] = 2000;
+	setBit( 32, true );
+	run( 5000000 );
+	CHECK( ints[2] == 3000 );
+	ints[0] = 500;
+	run( ( PERIOD + 1 ) * TIMERTICK );
+	CHECK( ints[2] < 3000 );
+	run( 1000000 );
+	CHECK( ints[1] < 600 );				// a wound up integral would hold the output at the limit for seconds
+}
+
+// Disabled the output is outMin, and enabling starts from outMin with an evaluation on the same scan
+static void enable() {
+	ladder( 1.0, 0.0, 0.0, 3000 );
+	ints[0] = 1200;
+	ints[1] = 200;
+	setBit( 32, true );
+	CList.execute();
+	CHECK( ints[2] == 1000 );
+	setBit( 32, false );
+	CList.execute();
+	CHECK( ints[2] == 0 );
+	ladder( 0.0, 1.0, 0.0, 60000 );
+	ints[0] = 300;
+	ints[1] = 200;
+	setBit( 32, true );
+	CList.execute();
+	CHECK( ints[2] == 100 );
+	setBit( 32, false );
+	CList.execute();
+	setBit( 32, true );
+	CList.execute();
+	CHECK( ints[2] == 100 );				// the integral restarted from outMin
+}
+
+// With a constant error and only Ki the output counts the evaluations. Over 5 s the count must
+// be exactly ticks / PERIOD although the evaluations are made up to a scan late
+static void period() {
+uint32_t evaluations, expected;
+	ladder( 0.0, 1.0, 0.0, 65000, LONG_SCAN_MICROS );
+	ints[0] = 300;
+	ints[1] = 200;
+	setBit( 32, true );
+	while ( hostMicros < 5000000 ) CList.execute();
+	evaluations = ints[2] / 100;
+	expected = tickCount / PERIOD + 1;			// the first one is made on the enabling scan
+	printf( "pid: %lu evaluations in %lu ticks with period %d and %d us scans\n", (unsigned long)evaluations,
+		(unsigned long)tickCount, PERIOD, LONG_SCAN_MICROS );
+	CHECK( evaluations == expected || evaluations + 1 == expected );
+}
+
+int main() {
+	step();
+	windup();
+	enable();
+	period();
+	printf( "pid: %s\n", hostFailures ? "FAILED" : "ok" );
+	return hostFailures ? 1 : 0;
+}
@@ -0,0 +1,54 @@
+/*
+ * test_profile.cpp
+ *
+ * CList.profile() must leave the ladder as it found it: same run time state, no extra ticks,
+ * no pending event scan, no EEPROM checkpoint and no scan monitor counts.
+ * Built with -DRETENTIVE -DEVENT_SCAN, see the Makefile.
+ */
+
+#include "host.h"
+
+extern volatile bool scanPending;
+
+int main() {
+uint8_t before[512], after[512];
+uint16_t size;
+uint32_t ticks, writes, start, realTicks;
+	hostReset();
+	CList.begin();
+	new Not( 0, 16 );
+	new Astable( 16, 17, 3, 4 );
+	new UpCounter( 17, 1, 8 );					// numeric 8 is retained
+	new Delay( 17, 1, 18, 5, 5 );
+	new DnCounter( 17, 1, 19, 10 );
+	while ( hostMicros < 50000 ) CList.run();
+	CHECK( ints[8] > 0 );
+
+	size = CList.snapshotSize();
+	CHECK( size <= sizeof(before) );
+	CList.snapshot( before );
+	scanPending = false;
+	ticks = tickCount;
+	writes = hostEepromWrites;
+	tickCount += RETAIN_INTERVAL;				// a checkpoint is due as soon as anything changes
+	ticks += RETAIN_INTERVAL;
+	start = hostMicros;
+
+	CHECK( CList.profile( 100, 0 ) );
+	CHECK( hostSerial.find( "isr," ) != std::string::npos );
+	CHECK( hostSerial.find( "scan,5," ) != std::string::npos );
+
+	// only the real ticks of the virtual time the SPI transfers took have passed, and only they request a scan
+	realTicks = hostMicros / TIMERTICK - start / TIMERTICK;
+	CHECK( realTicks > 0 );
+	CHECK( tickCount == ticks + realTicks );
+	CHECK( scanPending );
+
+	CList.snapshot( after );
+	CHECK( memcmp( before, after, size ) == 0 );
+	CHECK( hostEepromWrites == writes );
+	CHECK( CList.overruns() == 0 );
+
+	printf( "profile: %s\n", hostFailures ? "FAILED" : "ok" );
+	return hostFailures ? 1 : 0;
+}
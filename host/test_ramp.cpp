@@ -0,0 +1,87 @@
+/*
+ * test_ramp.cpp
+ *
+ * Ramp: the output moves at most 'step' every 'period' ticks, stops exactly on the target and stays
+ * inside its limits. PWMOut: 0 gives 0 % and fullScale or more 100 % duty on both kinds of pin,
+ * and the duty rises with the input in between.
+ */
+
+#include "host.h"
+
+#define SCAN_MICROS 300
+#define STEP 10
+#define PERIOD 5
+
+// In 0 = ramp input, 1 = ramp output, 2 = PWM input
+static void ladder() {
+	hostReset();
+	CList.begin();
+	new Ramp( 0, 1, STEP, PERIOD, 100, 900 );
+	new HostLoad( SCAN_MICROS - HOST_SPI_MICROS );
+}
+
+// Run until the ramp output settles, checking every move against the rate limit
+static uint32_t follow( uint16_t target ) {
+uint32_t start, lastMove;
+uint16_t prev;
+	start = lastMove = tickCount;
+	prev = ints[1];
+	ints[0] = target;
+	while ( tickCount - lastMove < 4 * PERIOD ) {
+		CList.execute();
+		if ( ints[1] == prev ) continue;
+		CHECK( ( ints[1] > prev ? ints[1] - prev : prev - ints[1] ) <= STEP );
+		CHECK( tickCount - lastMove >= PERIOD || lastMove == start );	// the first move may come at once
+		lastMove = tickCount;
+		prev = ints[1];
+	}
+	return lastMove - start;
+}
+
+static void ramp() {
+uint32_t ticks;
+	ladder();
+	ticks = follow( 2000 );				// clamped to the upper limit
+	printf( "ramp: 0 -> 900 at %u per %u ticks took %lu ticks\n", STEP, PERIOD, (unsigned long)ticks );
+	CHECK( ints[1] == 900 );
+	CHECK( ticks >= ( 900 / STEP - 1 ) * PERIOD && ticks <= ( 900 / STEP ) * ( PERIOD + 1 ) );
+	follow( 505 );						// a last step shorter than STEP lands on the target
+	CHECK( ints[1] == 505 );
+	follow( 0 );						// clamped to the lower limit
+	CHECK( ints[1] == 100 );
+}
+
+static void pwm( uint8_t pin, uint16_t top ) {
+uint32_t in;
+uint16_t prev = 0;
+	hostReset();
+	CList.begin();
+	new PWMOut( 2, pin, 1000 );
+	ints[2] = 0;
+	CList.execute();
+	CHECK( hostPwm[pin] == 0 );
+	for ( in = 0; in <= 1000; in++ ) {
+		ints[2] = in;
+		CList.execute();
+		CHECK( hostPwm[pin] >= prev && hostPwm[pin] <= top );
+		prev = hostPwm[pin];
+	}
+	CHECK( hostPwm[pin] == top );
+	ints[2] = 500;
+	CList.execute();
+	CHECK( hostPwm[pin] == top / 2 );
+	ints[2] = 60000;
+	CList.execute();
+	CHECK( hostPwm[pin] == top );
+	ints[2] = 0;
+	CList.execute();
+	CHECK( hostPwm[pin] == 0 );
+}
+
+int main() {
+	ramp();
+	pwm( 9, 1023 );
+	pwm( 5, 255 );
+	printf( "ramp: %s\n", hostFailures ? "FAILED" : "ok" );
+	return hostFailures ? 1 : 0;
+}
@@ -0,0 +1,38 @@
+/*
+ * test_resources.cpp
+ *
+ * A ladder with BITSPACE and INTSPACE of 256 (wide_ladder.h): begin() clears all of both spaces
+ * and the debug lists cover them. Such sizes used to hang begin() in an 8 bit loop.
+ * Built with wide_ladder.h, see the Makefile.
+ */
+
+#include "host.h"
+
+void listBits();
+void listTimers();
+
+int main() {
+uint16_t cnt;
+size_t values;
+	CHECK( BITSPACE == 256 && INTSPACE == 256 );
+	memset( bits, 0xFF, sizeof(bits) );
+	memset( ints, 0xFF, sizeof(ints) );
+	hostReset();
+	CList.begin();
+	PLC_BUILD();
+	for ( cnt = 0; cnt < BITSPACE; cnt++ ) CHECK( bits[cnt] == 0 );
+	for ( cnt = 0; cnt < INTSPACE; cnt++ ) CHECK( ints[cnt] == 0 );
+	setBit( 32, true );
+	CList.execute();
+	CHECK( ints[255] == 1 );
+	CHECK( Bit( 16 ) );
+	listBits();
+	for ( values = 0, cnt = 0; cnt < hostSerial.size(); cnt++ ) values += hostSerial[cnt] == ' ';
+	CHECK( values == BITSPACE );
+	hostSerial.clear();
+	listResources();
+	CHECK( hostSerial.find( "bytes of bits 256\n" ) != std::string::npos );
+	CHECK( hostSerial.find( "numerics 256\n" ) != std::string::npos );
+	printf( "resources: %s\n", hostFailures ? "FAILED" : "ok" );
+	return hostFailures ? 1 : 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * test_retain.cpp
+ *
+ * RETENTIVE test against the EEPROM stand-in: checkpoint and restore, a power cut after every
+ * byte of a checkpoint, and the measured EEPROM wear (which must allow at least a year of
+ * a value changing all the time) and scan cost of an hour of a busy ladder.
+ * Built with -DRETENTIVE, see the Makefile.
+ */
+
+#include "host.h"
+
+#define SCAN_MICROS 500				// modelled duration of one scan
+#define HOUR ( 3600UL * 1000000UL )
+
+struct ScanCost {
+	uint32_t maxReads, maxWrites;
+};
+
+// Scan until virtual time 'until', recording the EEPROM accesses of the worst scan
+static void runUntil( uint32_t until, ScanCost *cost ) {
+uint32_t reads, writes;
+	while ( hostMicros < until ) {
+		reads = hostEepromReads;
+		writes = hostEepromWrites;
+		CList.execute();
+		if ( cost ) {
+			if ( hostEepromReads - reads > cost->maxReads ) cost->maxReads = hostEepromReads - reads;
+			if ( hostEepromWrites - writes > cost->maxWrites ) cost->maxWrites = hostEepromWrites - writes;
+		}
+	}
+}
+
+static void powerOn() {
+	hostReset();
+	CList.begin();
+}
+
+// Retained numerics 8 and 9 and bit byte 4 all hold (copies of) the same value, so a torn checkpoint shows
+static void setRetained( uint16_t value ) {
+	ints[8] = value;
+	ints[9] = value;
+	bits[4] = value & 0xff;
+}
+
+static bool consistent() {
+	return ints[8] == ints[9] && bits[4] == ( ints[8] & 0xff );
+}
+
+// An hour of a counter changing ten times a second: bytes written and the cost per scan
+static void hour() {
+ScanCost cost = { 0, 0 };
+uint32_t cnt, maxCell, before;
+uint16_t count;
+	memset( hostEeprom, 0xFF, sizeof(hostEeprom) );
+	memset( hostEepromCellWrites, 0, sizeof(hostEepromCellWrites) );
+	powerOn();
+	setBit( 100, true );
+	new Astable( 100, 101, 50, 50 );
+	new UpCounter( 101, 102, 8 );
+	new UpCounter( 101, 102, 9 );
+	new Bistable( 101, 102, 32 );
+	new HostLoad( SCAN_MICROS );
+	hostEepromStalls = 0;
+	hostEepromWrites = 0;
+	runUntil( HOUR, &cost );
+	CHECK( hostEepromStalls == 0 );				// no scan ever waited for the EEPROM
+	CHECK( cost.maxWrites <= 1 );
+	CHECK( CList.retainWrites() == hostEepromWrites );
+	for ( cnt = 0, maxCell = 0; cnt <= E2END; cnt++ ) {
+		if ( hostEepromCellWrites[cnt] > maxCell ) maxCell = hostEepromCellWrites[cnt];
+	}
+	printf( "retain: %u scans/s, counter +10/s: %lu EEPROM bytes written per hour, busiest cell %lu writes per hour (%lu days to 100 000)\n",
+		1000000 / ( SCAN_MICROS + HOST_SPI_MICROS ), (unsigned long)hostEepromWrites, (unsigned long)maxCell,
+		(unsigned long)( 100000UL / maxCell / 24 ) );
+	// every checkpoint writes each byte of its slot at most once and the slots cover the whole EEPROM
+	CHECK( maxCell <= HOUR / ( (uint32_t)RETAIN_INTERVAL * TIMERTICK ) / RETAIN_SLOTS + 1 );
+	CHECK( 100000UL / maxCell / 24 >= 365 );		// the EEPROM lasts over a year of this at the default settings
+	printf( "retain: worst scan: %lu EEPROM reads and %lu write started, %lu waits\n",
+		(unsigned long)cost.maxReads, (unsigned long)cost.maxWrites, (unsigned long)hostEepromStalls );
+
+	// a power cut loses at most what changed since the last completed checkpoint
+	count = ints[8];
+	before = tickCount;
+	powerOn();
+	CHECK( ints[8] == ints[9] );
+	CHECK( Bit( 32 ) );
+	CHECK( ints[8] <= count );
+	CHECK( ints[8] + ( RETAIN_INTERVAL + 200 ) / 100 >= count );
+	CHECK( before > RETAIN_INTERVAL );
+}
+
+// Cut the power after each byte of a checkpoint: the restored values are always either
+// the previous checkpoint or the new one, never a mix
+static void cuts() {
+uint32_t k, start, deadline;
+bool done = false;
+	for ( k = 1; !done; k++ ) {
+		memset( hostEeprom, 0xFF, sizeof(hostEeprom) );
+		powerOn();
+		new HostLoad( SCAN_MICROS );
+		setRetained( 0x1111 );
+		runUntil( ( RETAIN_INTERVAL + 1000 ) * TIMERTICK, NULL );	// first checkpoint done
+		CHECK( CList.retainWrites() > 0 );
+		setRetained( 0x2222 );
+		start = CList.retainWrites();
+		deadline = ( 2 * RETAIN_INTERVAL + 1000 ) * TIMERTICK;
+		while ( CList.retainWrites() < start + k && hostMicros < deadline ) CList.execute();
+		done = CList.retainWrites() < start + k;		// the checkpoint needed fewer writes
+		powerOn();
+		CHECK( consistent() );
+		if ( done ) CHECK( ints[8] == 0x2222 );
+		else CHECK( ints[8] == 0x1111 || ints[8] == 0x2222 );
+	}
+	printf( "retain: power cut after each of the %lu writes of a checkpoint restores a whole checkpoint\n", (unsigned long)( k - 2 ) );
+	CHECK( k > 4 );
+}
+
+// Slots rotate, a restart continues the rotation and an empty EEPROM gives zeros
+static void slots() {
+uint8_t cnt;
+	memset( hostEeprom, 0xFF, sizeof(hostEeprom) );
+	powerOn();
+	CHECK( ints[8] == 0 && bits[4] == 0 );
+	new HostLoad( SCAN_MICROS );
+	for ( cnt = 1; cnt <= 2 * RETAIN_SLOTS + 3; cnt++ ) {
+		setRetained( cnt );
+		runUntil( hostMicros + ( RETAIN_INTERVAL + 1000 ) * TIMERTICK, NULL );
+		if ( cnt % 5 == 0 ) {						// restart now and then
+			powerOn();
+			CHECK( ints[8] == cnt && consistent() );
+			new HostLoad( SCAN_MICROS );
+		}
+	}
+	powerOn();
+	CHECK( ints[8] == 2 * RETAIN_SLOTS + 3 && consistent() );
+}
+
+int main() {
+	hour();
+	cuts();
+	slots();
+	printf( "retain: %s\n", hostFailures ? "FAILED" : "ok" );
+	return hostFailures ? 1 : 0;
+}
@@ -0,0 +1,103 @@
+/*
+ * test_scanmonitor.cpp
+ *
+ * Scan monitor (SCANBUDGET) and fail-safe (FAILSAFE_OVERRUNS) test.
+ * A HostLoad component in the middle of the ladder burns a given amount of virtual time.
+ * Built with -DSCANBUDGET=20 -DFAILSAFE_OVERRUNS=3, see the Makefile.
+ */
+
+#include "host.h"
+
+#define BUDGET_MICROS ( (uint32_t)SCANBUDGET * TIMERTICK )
+
+static HostLoad *slow;
+
+static void scans( uint8_t n ) {
+	while ( n-- ) CList.execute();
+}
+
+int main() {
+uint32_t start;
+	hostReset();
+	CList.begin();
+	new Not( 0, 16 );					// output 16 on while input 0 is off
+	slow = new HostLoad( 0 );			// component 1
+	new Not( 1, 17 );
+
+	// a ladder within budget is not reported
+	scans( 10 );
+	CHECK( CList.overruns() == 0 );
+	CHECK( CList.longestScanBlock() == NOBLOCK );
+	CHECK( !CList.failSafe() );
+	CHECK( ( hostOutputs & 0x0003 ) == 0x0003 );
+
+	// one scan over budget: counted and blamed on the slow block, no fail-safe yet
+	slow->cost = BUDGET_MICROS + 2 * TIMERTICK;
+	scans( 1 );
+	slow->cost = 0;
+	scans( 1 );
+	CHECK( CList.overruns() == 1 );
+	CHECK( CList.longestScanBlock() == 1 );
+	CHECK( CList.longestScan() > SCANBUDGET );
+	CHECK( !CList.failSafe() );
+
+	// FAILSAFE_OVERRUNS - 1 overruns in a row and a good scan restart the count
+	slow->cost = BUDGET_MICROS + 2 * TIMERTICK;
+	scans( FAILSAFE_OVERRUNS - 1 );
+	slow->cost = 0;
+	scans( 1 );
+	slow->cost = BUDGET_MICROS + 2 * TIMERTICK;
+	scans( FAILSAFE_OVERRUNS - 1 );
+	slow->cost = 0;
+	scans( 1 );
+	CHECK( CList.overruns() == 1 + 2 * ( FAILSAFE_OVERRUNS - 1 ) );
+	CHECK( !CList.failSafe() );
+	CHECK( !hostWdtEnabled );
+
+	// FAILSAFE_OVERRUNS in a row: outputs forced to the safe state and the watchdog armed
+	slow->cost = BUDGET_MICROS + 2 * TIMERTICK;
+	scans( FAILSAFE_OVERRUNS );
+	CHECK( CList.failSafe() );
+	CHECK( hostWdtEnabled );
+	CHECK( hostOutputs == FAILSAFE_OUTPUTS );
+
+	// the ladder keeps running but cannot drive the outputs, and every scan kicks the watchdog
+	slow->cost = 0;
+	hostWdtResets = 0;
+	scans( 5 );
+	CHECK( Bit( 16 ) );
+	CHECK( hostOutputs == FAILSAFE_OUTPUTS );
+	CHECK( hostWdtResets == 5 );
+
+	// released by the program
+	CList.clearFailSafe();
+	scans( 2 );
+	CHECK( !CList.failSafe() );
+	CHECK( !hostWdtEnabled );
+	CHECK( ( hostOutputs & 0x0003 ) == 0x0003 );
+
+	// a runaway scan that never gets to the accounting is caught by the timer interrupt
+	CList.clearScanStats();
+	slow->cost = BUDGET_MICROS * FAILSAFE_OVERRUNS + 2 * TIMERTICK;
+	start = hostMicros;
+	scans( 1 );
+	CHECK( hostOutputs == FAILSAFE_OUTPUTS );
+	CHECK( hostOutputTime > start && hostOutputTime < start + slow->cost );	// out while the block was still running
+	CHECK( CList.failSafe() );
+	CHECK( hostWdtEnabled );
+	CHECK( CList.overruns() == 1 );
+	CHECK( CList.longestScanBlock() == 1 );
+	CHECK( CList.longestScan() > (uint32_t)SCANBUDGET * FAILSAFE_OVERRUNS );
+	CList.clearFailSafe();
+
+	// clearScanStats() starts over
+	slow->cost = 0;
+	CList.clearScanStats();
+	scans( 3 );
+	CHECK( CList.overruns() == 0 );
+	CHECK( CList.longestScanBlock() == NOBLOCK );
+	CHECK( CList.longestScan() <= 1 );
+
+	printf( "scan monitor: %s\n", hostFailures ? "FAILED" : "ok" );
+	return hostFailures ? 1 : 0;
+}
@@ -0,0 +1,142 @@
+/*
+ * test_sequencer.cpp
+ *
+ * A Sequencer step ring moves exactly like the equivalent Bistable ladder of the benchmark
+ * (steps.h), parallel branches split and join, the step bits may start anywhere in a byte,
+ * a step time beyond 16 bits is waited out in full and a timed step beyond MAXTIMERS is refused.
+ * Built with bench_ladder.h, see the Makefile.
+ */
+
+#include "steps.h"
+
+static uint32_t seed = 1;
+
+static uint32_t random( uint32_t range ) {
+	seed = seed * 1103515245UL + 12345;
+	return ( seed >> 8 ) % range;
+}
+
+// Both forms side by side on random conditions: the same step is active after every scan
+static void ring() {
+uint32_t scan, moves = 0, differ = 0;
+uint8_t k, last = 0;
+	hostReset();
+	CList.begin();
+	stepsSequencer();
+	stepsLadder();
+	for ( scan = 0; scan < 20000; scan++ ) {
+		for ( k = 0; k < STEPS; k++ ) setBit( STEP_COND + k, random( 4 ) == 0 );
+		CList.execute();
+		for ( k = 0; k < STEPS; k++ ) {
+			if ( Bit( STEP_SEQ + k ) != Bit( STEP_LADDER + k ) ) differ++;
+			if ( Bit( STEP_SEQ + k ) && k != last ) {
+				moves++;
+				last = k;
+			}
+		}
+	}
+	printf( "sequencer: %lu moves in 20000 scans, same steps as the Bistable ladder\n", (unsigned long)moves );
+	CHECK( differ == 0 );
+	CHECK( moves > 1000 );
+}
+
+// Steps of the parallel branch test, in the order they are active
+static uint8_t activeSteps( logicBit first ) {
+uint8_t k, steps = 0;
+	for ( k = 0; k < 6; k++ ) if ( Bit( first + k ) ) steps |= 1 << k;
+	return steps;
+}
+
+// The bits around the 6 step bits, from the byte before to the byte after
+static bool neighbours( logicBit first, bool set ) {
+logicBit k;
+bool all = true;
+	for ( k = first / 8 * 8 - 8; k < ( first + 6 ) / 8 * 8 + 16; k++ ) {
+		if ( k >= first && k < first + 6 ) continue;
+		if ( set ) setBit( k, true );
+		all = all && Bit( k );
+	}
+	return all;
+}
+
+// Step 0 branches into 1 and 2 on condition D, 1 goes on to 3 on condition A and 2 to 4 on condition B,
+// and 3 and 4 join into 5 on condition C. 5 goes back to 0 on A. Bits A, B, C, D = STEP_COND...STEP_COND + 3.
+// The bits around the steps are all '1' and must neither be taken for steps nor changed.
+static void branches( logicBit first ) {
+Sequencer *seq;
+	hostReset();
+	CList.begin();
+	seq = new Sequencer( 0, first, 6, 5, 0 );
+	neighbours( first, true );
+	seq->transition( 0, 1, STEP_COND + 3, 0 );
+	seq->branch( 2 );
+	seq->transition( 1, 3, STEP_COND, 0 );
+	seq->transition( 2, 4, STEP_COND + 1, 0 );
+	seq->transition( 3, 5, STEP_COND + 2, 0 );
+	seq->join( 4 );
+	seq->transition( 5, 0, STEP_COND, 0 );
+	CHECK( activeSteps( first ) == 0x01 );
+	setBit( STEP_COND + 3, true );
+	CList.execute();
+	CHECK( activeSteps( first ) == 0x06 );				// both branches start
+	setBit( STEP_COND + 3, false );
+	setBit( STEP_COND + 2, true );
+	setBit( STEP_COND, true );
+	CList.execute();
+	CHECK( activeSteps( first ) == 0x0C );				// only the first branch moves on
+	setBit( STEP_COND, false );
+	CList.execute();
+	CList.execute();
+	CHECK( activeSteps( first ) == 0x0C );				// the join waits for the second branch
+	setBit( STEP_COND + 1, true );
+	CList.execute();
+	CHECK( activeSteps( first ) == 0x18 );				// both branches at their last step
+	CList.execute();
+	CHECK( activeSteps( first ) == 0x20 );				// joined: 3 and 4 both left
+	setBit( STEP_COND, true );
+	CList.execute();
+	CHECK( activeSteps( first ) == 0x01 );
+	CHECK( neighbours( first, false ) );
+}
+
+// 70000 ticks does not fit in 16 bits
+static void longTime() {
+Sequencer *seq;
+	hostReset();
+	CList.begin();
+	seq = new Sequencer( 0, STEP_SEQ, 2, 2, 0 );
+	seq->transition( 0, 1, STEP_COND, 70000 );
+	seq->transition( 1, 0, STEP_COND, 0 );
+	setBit( STEP_COND, true );
+	CList.execute();
+	hostAdvance( 69990UL * TIMERTICK );
+	CList.execute();
+	CHECK( Bit( STEP_SEQ ) && !Bit( STEP_SEQ + 1 ) );
+	hostAdvance( 20UL * TIMERTICK );
+	CList.execute();
+	CHECK( !Bit( STEP_SEQ ) && Bit( STEP_SEQ + 1 ) );
+}
+
+// Only untimed transitions and transitions from an already timed step can be added when the timers are used up
+static void timersOut() {
+Sequencer *seq;
+	hostReset();
+	CList.begin();
+	seq = new Sequencer( 0, STEP_SEQ, 3, 4, 0 );
+	CHECK( seq->transition( 0, 1, STEP_COND, 10 ) == 0 );
+	timerCount = MAXTIMERS;
+	CHECK( seq->transition( 1, 2, STEP_COND, 10 ) == NOSTEP );
+	CHECK( seq->transition( 1, 2, STEP_COND, 0 ) == 1 );
+	CHECK( seq->transition( 0, 2, STEP_COND + 1, 20 ) == 2 );
+	CHECK( timerCount == MAXTIMERS );
+}
+
+int main() {
+	ring();
+	branches( STEP_SEQ );
+	branches( STEP_SEQ + 5 );								// step bits across a byte boundary
+	longTime();
+	timersOut();
+	printf( "sequencer: %s\n", hostFailures ? "FAILED" : "ok" );
+	return hostFailures ? 1 : 0;
+}
@@ -0,0 +1,126 @@
+/*
+ * test_snapshot.cpp
+ *
+ * Forks of a ladder with PID loops, one on its own and two as instances of a FunctionBlock, each
+ * against a simulated first order plant. A snapshot taken in the middle of the step response is
+ * restored straight away and again 4 ticks later: both forks, and the run that simply went on,
+ * must give the same outputs scan by scan. Also checks that a PID in a FunctionBlock keeps its
+ * period. The cost of a fork is in the benchmark (fork.*).
+ */
+
+#include <vector>
+#include "host.h"
+
+#define SCAN_MICROS 700
+#define PERIOD 10					// ticks between PID evaluations
+#define EVALUATIONS 40				// compared after each restore
+#define LOOPS 3
+
+// Loop k: set point, process value and output in loopInts[k][]. Bit 32 enables all
+static const numeric loopInts[LOOPS][3] = { { 0, 1, 2 }, { 3, 4, 5 }, { 11, 12, 13 } };
+static double plant[LOOPS];
+
+// The function block: bit 80 enable, numerics 8 ... 10 set point, process value and output
+static void ladder( float kp, float ki, float kd, uint16_t outMax ) {
+FunctionBlock *fb;
+static const logicBit fbBits[1] = { 32 };
+	hostReset();
+	CList.begin();
+	new PID( 32, 0, 1, 2, kp, ki, kd, PERIOD, 0, outMax );
+	fb = new FunctionBlock( 10, 1, 1, 0, 8, 3, 2, 1, 2 );
+	fb->define();
+	new PID( 80, 8, 9, 10, kp, ki, kd, PERIOD, 0, outMax );
+	fb->endDefine();
+	fb->instance( fbBits, loopInts[1] );
+	fb->instance( fbBits, loopInts[2] );
+	new HostLoad( SCAN_MICROS - HOST_SPI_MICROS );
+}
+
+// One scan, then the plants move towards the outputs with a 200 ms time constant
+static void scan() {
+uint32_t last;
+uint8_t k;
+	last = hostMicros;
+	CList.execute();
+	for ( k = 0; k < LOOPS; k++ ) {
+		plant[k] += ( ints[loopInts[k][2]] - plant[k] ) * ( hostMicros - last ) / 200000.0;
+		ints[loopInts[k][1]] = plant[k] + 0.5;
+	}
+}
+
+// The outputs of every scan for EVALUATIONS periods
+static std::vector<uint16_t> trace() {
+std::vector<uint16_t> outputs;
+uint32_t until;
+uint8_t k;
+	until = hostMicros + EVALUATIONS * PERIOD * TIMERTICK;
+	while ( hostMicros < until ) {
+		scan();
+		for ( k = 0; k < LOOPS; k++ ) outputs.push_back( ints[loopInts[k][2]] );
+	}
+	return outputs;
+}
+
+// Wait for the same moment within a tick as 'phase'
+static void align( uint32_t phase ) {
+	hostAdvance( ( phase + TIMERTICK - hostMicros % TIMERTICK ) % TIMERTICK );
+}
+
+static void fork() {
+std::vector<uint8_t> blob;
+std::vector<uint16_t> straight, early, late;
+double saved[LOOPS];
+uint32_t phase;
+uint8_t k;
+	ladder( 0.5, 0.05, 2.0, 4000 );
+	for ( k = 0; k < LOOPS; k++ ) {
+		plant[k] = 0;
+		ints[loopInts[k][0]] = 1000 + 500 * k;
+	}
+	setBit( 32, true );
+	while ( hostMicros < 305000 ) scan();			// half way between two evaluations
+	blob.resize( CList.snapshotSize() );
+	CList.snapshot( blob.data() );
+	memcpy( saved, plant, sizeof(plant) );
+	phase = hostMicros % TIMERTICK;
+	straight = trace();
+	align( phase );
+	CList.restore( blob.data() );
+	memcpy( plant, saved, sizeof(plant) );
+	early = trace();
+	align( phase );
+	hostAdvance( 4 * TIMERTICK );
+	CList.restore( blob.data() );
+	memcpy( plant, saved, sizeof(plant) );
+	late = trace();
+	CHECK( early == straight );
+	CHECK( late == straight );
+	CHECK( straight.front() != straight.back() );		// the loops were still moving
+	printf( "snapshot: %u bytes, %u outputs the same in both forks and the run that went on\n",
+		(unsigned)blob.size(), (unsigned)straight.size() );
+}
+
+// With a constant error and only Ki each output counts the evaluations: the instances of the
+// function block must keep the period as well as the PID on its own
+static void period() {
+uint16_t evaluations;
+uint8_t k;
+	ladder( 0.0, 1.0, 0.0, 65000 );
+	for ( k = 0; k < LOOPS; k++ ) {
+		ints[loopInts[k][0]] = 300;
+		ints[loopInts[k][1]] = 200;
+	}
+	setBit( 32, true );
+	while ( hostMicros < 1000000 ) CList.execute();
+	for ( k = 0; k < LOOPS; k++ ) {
+		evaluations = ints[loopInts[k][2]] / 100;
+		CHECK( evaluations == tickCount / PERIOD + 1 || evaluations == tickCount / PERIOD );
+	}
+}
+
+int main() {
+	fork();
+	period();
+	printf( "snapshot: %s\n", hostFailures ? "FAILED" : "ok" );
+	return hostFailures ? 1 : 0;
+}
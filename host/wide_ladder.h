@@ -0,0 +1,10 @@
+/*
+ * wide_ladder.h
+ *
+ * Ladder header of test_resources (PLC_LADDER_FILE): a bit and a numeric at the very end of the
+ * numbering, so that BITSPACE and INTSPACE both come to 256.
+ */
+
+#define PLC_LADDER(X) \
+	X( UpCounter, ( 32, 33, 255 ) ) \
+	X( Not, ( 2047, 16 ) )
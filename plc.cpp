@@ -14,8 +14,25 @@
 #include "plc.h"
 #include <SPI.h>
 #include <TimerOne.h>
+#ifdef FAILSAFE_OVERRUNS
+#ifndef SCANBUDGET
+#error "FAILSAFE_OVERRUNS needs SCANBUDGET"
+#endif
+#include <avr/wdt.h>
+#endif
+#ifdef RETENTIVE
+#include <avr/eeprom.h>
+#endif
+#ifdef EVENT_SCAN
+#include <avr/sleep.h>
+#endif
+#ifdef I2CLINK
+#include <util/twi.h>
+#endif
 
+#ifndef UINT16_MAX
 #define UINT16_MAX 65535
+#endif
 
 // Arduino outputs for the shift register strobe latches
 #define OE 12		// 595 output strobe/enable
@@ -28,18 +45,431 @@ SPISettings spiSettings( SPICLOCK, MSBFIRST, SPI_MODE0 );
 
 uint8_t timerCount = 0;
 volatile uint32_t timers[MAXTIMERS];
+volatile uint32_t tickCount = 0;	// free running count of Timer1 ticks
+uint32_t frameTime = 0;				// the tick that times in component frames are relative to
+
+#ifdef EVENT_SCAN
+volatile bool scanPending = true;	// a scan has been requested by the event pin or the timer
+uint8_t eventTicks = 0;				// timer ticks since the last timed scan request
+
+// Interrupt handler for the event pin
+void eISR() {
+	scanPending = true;
+}
+#endif
+
+#ifdef SCANBUDGET
+// Scan monitor bookkeeping. The ISR watches the running scan, execute() does the accounting
+volatile bool scanning = false;		// true while the components are being executed
+volatile bool scanOverrun;			// the running scan has exceeded SCANBUDGET
+volatile uint8_t scanBlock;			// index of the component currently executing
+volatile uint8_t overrunBlock;		// scanBlock at the moment the budget ran out
+volatile uint32_t scanStart;		// tickCount when the running scan started
+uint16_t overrunCount = 0;
+uint32_t maxScanTicks = 0;
+uint8_t maxScanBlock = NOBLOCK;
+#ifdef FAILSAFE_OVERRUNS
+uint8_t consecutiveOverruns = 0;
+volatile bool failSafeActive = false;
+#endif
+#endif
+
+#ifdef RETENTIVE
+// Retentive variables. The retained bytes of bits[] and ints[] are checkpointed to EEPROM
+// in RETAIN_SLOTS rotating slots that fill the EEPROM from RETAIN_EEPROM_BASE up (see plc.h).
+// Slot layout: [sequence][checksum][RETAIN_SIZE data bytes]. The checksum covers the sequence number
+// and the data. A checkpoint writes the data, then the checksum and last the sequence number, so until
+// the very last byte the slot either fails its checksum or still carries its old sequence number, and
+// in both cases the previous slot stays the newest valid one.
+// Only one EEPROM byte write is started per scan and only when the EEPROM is idle, so a scan
+// never waits for the ~3.4ms write cycle. Bytes already holding the right value are not rewritten.
+#define RETAIN_INVALID 0xFF
+
+static_assert( RETAIN_BIT_FIRST <= RETAIN_BIT_LAST && RETAIN_BIT_LAST / 8 < BITSPACE, "RETENTIVE: RETAIN_BIT_FIRST...RETAIN_BIT_LAST must be inside BITSPACE" );
+static_assert( RETAIN_INT_FIRST <= RETAIN_INT_LAST && RETAIN_INT_LAST < INTSPACE, "RETENTIVE: RETAIN_INT_FIRST...RETAIN_INT_LAST must be inside INTSPACE" );
+static_assert( RETAIN_EEPROM_BASE <= E2END && RETAIN_SLOTS >= 2, "RETENTIVE: two slots must fit in the EEPROM after RETAIN_EEPROM_BASE" );
+static_assert( RETAIN_SLOTS < RETAIN_INVALID, "RETENTIVE: too many slots for the 8 bit sequence number, raise RETAIN_EEPROM_BASE" );
+
+uint8_t retainImage[RETAIN_SIZE];	// the snapshot being written (or last written) to EEPROM
+uint8_t retainSum;					// checksum of retainImage and retainSeq
+uint8_t retainSlot;					// slot being written (or last written)
+uint8_t retainSeq;					// sequence number of that slot
+int16_t retainPos = -1;				// checkpoint progress, -1 when idle
+uint32_t retainTime;				// tickCount at the start of the last checkpoint
+uint32_t retainWriteCount = 0;		// number of EEPROM bytes written since begin()
+
+// Copy the retained part of bits[] and ints[] into 'image'
+static void retainCopy( uint8_t *image ) {
+	memcpy( image, &bits[RETAIN_BIT_FIRST/8], RETAIN_BITBYTES );
+	memcpy( image + RETAIN_BITBYTES, &ints[RETAIN_INT_FIRST], RETAIN_SIZE - RETAIN_BITBYTES );
+}
+
+// Copy 'image' back into bits[] and ints[]
+static void retainRestore( const uint8_t *image ) {
+	memcpy( &bits[RETAIN_BIT_FIRST/8], image, RETAIN_BITBYTES );
+	memcpy( &ints[RETAIN_INT_FIRST], image + RETAIN_BITBYTES, RETAIN_SIZE - RETAIN_BITBYTES );
+}
+
+// True if the live variables differ from retainImage
+static bool retainChanged() {
+	return memcmp( retainImage, &bits[RETAIN_BIT_FIRST/8], RETAIN_BITBYTES ) ||
+		memcmp( retainImage + RETAIN_BITBYTES, &ints[RETAIN_INT_FIRST], RETAIN_SIZE - RETAIN_BITBYTES );
+}
+
+// The checksum is seeded with the image size so that changing the retained ranges invalidates old slots
+static uint8_t retainChecksum( const uint8_t *image, uint8_t seq ) {
+uint16_t cnt;
+uint8_t sum = RETAIN_SIZE ^ seq;
+	for ( cnt = 0; cnt < RETAIN_SIZE; cnt++ ) sum = ( sum << 1 | sum >> 7 ) ^ image[cnt];
+	return sum;
+}
+
+static uint8_t *retainAddress( uint8_t slot, uint16_t offset ) {
+	return (uint8_t *)(uintptr_t)( RETAIN_EEPROM_BASE + slot * RETAIN_SLOTSIZE + offset );
+}
+
+// Read a slot into retainImage. Returns its sequence number, or RETAIN_INVALID if the slot is not valid
+static uint8_t retainRead( uint8_t slot ) {
+uint16_t cnt;
+uint8_t seq;
+	seq = eeprom_read_byte( retainAddress( slot, 0 ) );
+	if ( seq == RETAIN_INVALID ) return RETAIN_INVALID;
+	for ( cnt = 0; cnt < RETAIN_SIZE; cnt++ ) retainImage[cnt] = eeprom_read_byte( retainAddress( slot, cnt + 2 ) );
+	return eeprom_read_byte( retainAddress( slot, 1 ) ) == retainChecksum( retainImage, seq ) ? seq : RETAIN_INVALID;
+}
+
+// Find the newest valid slot and load it into bits[] and ints[]. Called from begin()
+static void retainLoad() {
+uint8_t slot, seq, nextSeq, firstSeq;
+	// slots are written in rotation with consecutive sequence numbers, the newest is where the chain breaks
+	retainSlot = RETAIN_SLOTS - 1;
+	retainSeq = RETAIN_INVALID - 1;
+	firstSeq = seq = retainRead( 0 );
+	for ( slot = 0; slot < RETAIN_SLOTS; slot++ ) {
+		nextSeq = slot + 1 < RETAIN_SLOTS ? retainRead( slot + 1 ) : firstSeq;
+		if ( seq != RETAIN_INVALID && !( nextSeq != RETAIN_INVALID && nextSeq == ( seq + 1 ) % RETAIN_INVALID ) ) {
+			retainRead( slot );
+			retainRestore( retainImage );
+			retainSlot = slot;
+			retainSeq = seq;
+			break;
+		}
+		seq = nextSeq;
+	}
+	retainCopy( retainImage );
+	retainPos = -1;
+	retainTime = 0;
+}
+
+// Start an EEPROM write of 'value' if the byte does not hold it already. Returns true if a write was started
+static bool retainUpdate( uint8_t *address, uint8_t value ) {
+	if ( eeprom_read_byte( address ) == value ) return false;
+	eeprom_write_byte( address, value );
+	retainWriteCount++;
+	return true;
+}
+
+// Advance the checkpoint by at most one byte write. Called at the end of every scan
+static void retainService() {
+uint32_t tmpTicks;
+uint8_t *address;
+uint8_t value;
+	if ( !eeprom_is_ready() ) return;
+	if ( retainPos < 0 ) {
+		cli();
+		tmpTicks = tickCount;
+		sei();
+		if ( tmpTicks - retainTime < RETAIN_INTERVAL || !retainChanged() ) return;
+		retainTime = tmpTicks;
+		retainCopy( retainImage );
+		retainSlot = ( retainSlot + 1 ) % RETAIN_SLOTS;
+		retainSeq = ( retainSeq + 1 ) % RETAIN_INVALID;
+		retainSum = retainChecksum( retainImage, retainSeq );
+		retainPos = 0;
+	}
+	while ( retainPos >= 0 ) {
+		if ( retainPos < RETAIN_SIZE ) {				// data
+			address = retainAddress( retainSlot, retainPos + 2 );
+			value = retainImage[retainPos];
+		}
+		else if ( retainPos == RETAIN_SIZE ) {			// checksum
+			address = retainAddress( retainSlot, 1 );
+			value = retainSum;
+		}
+		else {											// commit
+			address = retainAddress( retainSlot, 0 );
+			value = retainSeq;
+		}
+		retainPos = ( retainPos > RETAIN_SIZE ) ? -1 : retainPos + 1;
+		if ( retainUpdate( address, value ) ) return;
+	}
+}
+#endif
+
+#ifdef I2CLINK
+// Node to node link. Messages are I2C general calls (address 0) so every node receives them.
+// Message layout: [sender node][sequence][image address low][image address high][data...]
+// The image address of bit byte n is n and of numeric n it is BITSPACE + 2 * n.
+// The TWI interrupt handler sends our message and queues incoming ones; all the rest is done
+// between scans: linkService() picks the changed bytes to send and linkReceive() applies the queue.
+// A general call is acknowledged if any node takes it, so a sender cannot know that every node got
+// a message. Therefore every LINK_REFRESH ticks the next published bytes are resent in turn whatever
+// else changes, and a lost message is made good within LINK_REFRESH * (published bytes / LINK_FRAME) ticks.
+// Arbitration always lets the lower node number win, so a node with something to send at every scan
+// would keep the others off the bus for good. After each message a node therefore keeps quiet for
+// LINK_NODES - 1 times as long as the message took: every node gets at most its share of the bus.
+#define LINK_OFF 0xFF							// linkNode before linkBegin()
+#define LINK_HEADER 4
+#define LINK_RXFRAMES 4
+#define LINK_IMAGE ( BITSPACE + 2 * INTSPACE )
+#define TWI_ACK ( _BV(TWINT) | _BV(TWEN) | _BV(TWIE) | _BV(TWEA) )
+// Ticks to keep quiet after a message of 'len' bytes: the address byte and 'len' bytes of 9 clocks each, LINK_NODES - 1 times
+#define LINK_SHARE(len) ( ( ( LINK_NODES - 1 ) * ( (len) + 1 ) * 9UL * 1000000UL / LINK_CLOCK + TIMERTICK - 1 ) / TIMERTICK )
+
+uint8_t linkNode = LINK_OFF;					// our node number
+uint16_t linkBitByte, linkBitBytes;				// published bit bytes
+numeric linkInt;
+uint16_t linkIntBytes;							// published numerics (in bytes)
+uint8_t *linkShadow = NULL;						// published bytes as last sent successfully
+uint16_t linkCursor = 0;						// where to look for changes next
+uint16_t linkRefreshCursor = 0;					// where the next refresh starts
+uint16_t linkTxFirst;							// first published byte in the message being sent
+uint8_t linkSeq = 0;
+uint32_t linkLastRefresh = 0;
+uint16_t linkTxErrorCount = 0;
+uint32_t linkTxDone = 0;						// when our last message was seen to get through
+uint16_t linkTxShare = 0;						// ticks to keep quiet after it
+uint32_t linkSeen[LINK_NODES];
+uint8_t linkNextSeq[LINK_NODES];
+uint16_t linkErrorCount[LINK_NODES];
+
+uint8_t linkTxBuf[LINK_HEADER + LINK_FRAME];
+volatile uint8_t linkTxLen, linkTxPos;
+volatile bool linkTxBusy = false;				// a message is being sent
+volatile bool linkTxOk = false;					// the last message was acknowledged, update the shadow
+uint8_t linkRxBuf[LINK_RXFRAMES][LINK_HEADER + LINK_FRAME];
+volatile uint8_t linkRxLen[LINK_RXFRAMES];
+volatile uint8_t linkRxHead = 0, linkRxTail = 0;	// ISR fills at head, linkReceive() empties at tail
+volatile uint8_t linkRxPos;
+volatile bool linkRxOverflow;
+
+ISR(TWI_vect) {
+	switch ( TW_STATUS ) {
+		case TW_START:
+		case TW_REP_START:
+			TWDR = 0x00;							// general call, write
+			linkTxPos = 0;
+			TWCR = TWI_ACK;
+			break;
+		case TW_MT_SLA_ACK:
+		case TW_MT_DATA_ACK:
+			if ( linkTxPos < linkTxLen ) {
+				TWDR = linkTxBuf[linkTxPos++];
+				TWCR = TWI_ACK;
+			}
+			else {
+				TWCR = TWI_ACK | _BV(TWSTO);
+				linkTxOk = true;
+				linkTxBusy = false;
+			}
+			break;
+		case TW_MT_SLA_NACK:						// nobody listening
+		case TW_MT_DATA_NACK:
+			TWCR = TWI_ACK | _BV(TWSTO);
+			linkTxErrorCount++;
+			linkTxBusy = false;
+			break;
+		case TW_MT_ARB_LOST:						// another node won the bus, try again when it is free
+			TWCR = TWI_ACK | _BV(TWSTA);
+			break;
+		case TW_SR_GCALL_ACK:
+		case TW_SR_ARB_LOST_GCALL_ACK:
+			linkRxPos = 0;
+			linkRxOverflow = ( ( linkRxHead + 1 ) % LINK_RXFRAMES == linkRxTail );
+			TWCR = TWI_ACK;
+			break;
+		case TW_SR_GCALL_DATA_ACK:
+			if ( linkRxPos < LINK_HEADER + LINK_FRAME && !linkRxOverflow ) linkRxBuf[linkRxHead][linkRxPos++] = TWDR;
+			else linkRxOverflow = true;
+			TWCR = TWI_ACK;
+			break;
+		case TW_SR_STOP:
+			if ( linkRxPos > LINK_HEADER && !linkRxOverflow ) {
+				linkRxLen[linkRxHead] = linkRxPos;
+				linkRxHead = ( linkRxHead + 1 ) % LINK_RXFRAMES;
+			}
+			linkRxPos = 0;
+			TWCR = linkTxBusy ? TWI_ACK | _BV(TWSTA) : TWI_ACK;	// resume our own message if it lost arbitration
+			break;
+		case TW_BUS_ERROR:
+			TWCR = TWI_ACK | _BV(TWSTO);
+			linkTxErrorCount++;
+			linkTxBusy = false;
+			break;
+		default:									// addressed directly or other states, nothing to do
+			TWCR = TWI_ACK;
+			break;
+	}
+}
+
+// Pointer to published byte n (bit bytes first, then numerics) and its image address
+static uint8_t *linkByte( uint16_t n ) {
+	if ( n < linkBitBytes ) return &bits[linkBitByte + n];
+	return (uint8_t *)&ints[linkInt] + ( n - linkBitBytes );
+}
+
+static uint16_t linkAddress( uint16_t n ) {
+	if ( n < linkBitBytes ) return linkBitByte + n;
+	return BITSPACE + 2 * linkInt + ( n - linkBitBytes );
+}
+
+// Apply the received messages. Called at the start of a scan
+static void linkReceive() {
+uint8_t *frame;
+uint8_t len, node;
+uint16_t address;
+uint32_t tmpTicks;
+	cli();
+	tmpTicks = tickCount;
+	sei();
+	while ( linkRxTail != linkRxHead ) {
+		frame = linkRxBuf[linkRxTail];
+		len = linkRxLen[linkRxTail] - LINK_HEADER;
+		node = frame[0];
+		address = frame[2] | ( frame[3] << 8 );
+		if ( node < LINK_NODES && node != linkNode ) {
+			if ( address >= 2 && address + len <= LINK_IMAGE ) {	// never overwrite the inputs
+				if ( address + len <= BITSPACE ) memcpy( &bits[address], frame + LINK_HEADER, len );
+				else if ( address >= BITSPACE ) memcpy( (uint8_t *)ints + address - BITSPACE, frame + LINK_HEADER, len );
+				else linkErrorCount[node]++;			// a message never spans both spaces
+				if ( linkSeen[node] != UINT32_MAX && frame[1] != linkNextSeq[node] ) linkErrorCount[node]++;	// messages were lost
+				linkNextSeq[node] = frame[1] + 1;
+				linkSeen[node] = tmpTicks;
+			}
+			else linkErrorCount[node]++;
+		}
+		linkRxTail = ( linkRxTail + 1 ) % LINK_RXFRAMES;
+	}
+}
+
+// Send the next refresh if one is due, else the next run of changed published bytes. Called at the end of a scan
+static void linkService() {
+uint16_t size, cnt, first, last, pos;
+uint32_t tmpTicks;
+bool refresh;
+	if ( linkNode == LINK_OFF || linkTxBusy ) return;
+	cli();
+	tmpTicks = tickCount;
+	sei();
+	size = linkBitBytes + linkIntBytes;
+	if ( linkTxOk ) {			// the last message got through, remember what was sent
+		linkTxOk = false;
+		memcpy( linkShadow + linkTxFirst, linkTxBuf + LINK_HEADER, linkTxLen - LINK_HEADER );
+		linkTxDone = tmpTicks;
+		linkTxShare = LINK_SHARE( linkTxLen );
+	}
+	if ( size == 0 || tmpTicks - linkTxDone < linkTxShare ) return;
+	for ( cnt = 0; cnt < size; cnt++ ) {
+		first = ( linkCursor + cnt ) % size;
+		if ( *linkByte( first ) != linkShadow[first] ) break;
+	}
+	refresh = ( tmpTicks - linkLastRefresh >= LINK_REFRESH );
+	if ( refresh ) {			// the next bytes in turn, changed or not
+		first = linkRefreshCursor;
+		last = first + LINK_FRAME - 1;
+	}
+	else if ( cnt == size ) return;
+	else {						// send up to the last changed byte that fits in the message
+		last = first;
+		for ( pos = first + 1; pos < size && pos < first + LINK_FRAME; pos++ ) {
+			if ( *linkByte( pos ) != linkShadow[pos] ) last = pos;
+		}
+	}
+	if ( first < linkBitBytes && last >= linkBitBytes ) last = linkBitBytes - 1;	// one message, one address range
+	if ( last >= size ) last = size - 1;
+	if ( first >= linkBitBytes ) {					// whole numerics only, the receiver must not see half of one
+		if ( ( first - linkBitBytes ) & 1 ) first--;
+		if ( !( ( last - linkBitBytes ) & 1 ) ) last++;
+		if ( last - first >= LINK_FRAME ) last -= 2;
+	}
+	linkTxBuf[0] = linkNode;
+	linkTxBuf[1] = linkSeq++;
+	linkTxBuf[2] = linkAddress( first ) & 0xff;
+	linkTxBuf[3] = linkAddress( first ) >> 8;
+	for ( pos = first; pos <= last; pos++ ) linkTxBuf[LINK_HEADER + pos - first] = *linkByte( pos );
+	linkTxLen = LINK_HEADER + last - first + 1;
+	linkTxFirst = first;
+	if ( refresh ) {
+		linkRefreshCursor = ( last + 1 ) % size;
+		linkLastRefresh = tmpTicks;
+	}
+	else linkCursor = ( last + 1 ) % size;
+	linkTxBusy = true;
+	TWCR = TWI_ACK | _BV(TWSTA);
+}
+#endif
+
+// Clock the outputs out to the 595s and the inputs in from the 165s. Returns the input image
+static uint16_t transferIO( uint16_t outputs ) {
+uint16_t inputs;
+	digitalWrite(STROBE, LOW);
+	digitalWrite(STROBE, HIGH);
+	inputs = SPI.transfer16(outputs);
+	digitalWrite(OE, HIGH);
+	digitalWrite(OE, LOW);
+	return inputs;
+}
+
+// The output image to clock out: the output bits, or the safe state once in fail-safe
+static uint16_t outputImage() {
+#ifdef FAILSAFE_OVERRUNS
+	if ( failSafeActive ) return FAILSAFE_OUTPUTS;
+#endif
+	return bits[2] | ( bits[3] << 8 );
+}
+
+#ifdef FAILSAFE_OVERRUNS
+// Force the outputs to the safe state and arm the watchdog.
+// Called either from execute() or from the ISR if a scan never finishes.
+static void enterFailSafe() {
+	failSafeActive = true;
+	bits[2] = FAILSAFE_OUTPUTS & 0xff;
+	bits[3] = FAILSAFE_OUTPUTS >> 8;
+	transferIO(FAILSAFE_OUTPUTS);
+	wdt_enable(FAILSAFE_WDTO);
+}
+#endif
 
 // Interrupt handler for the PLC timers
 void tISR() {
 uint8_t cnt;
+	tickCount++;
 	for ( cnt = 0; cnt < timerCount; cnt++ ) {
 		if ( timers[cnt] > 0 ) timers[cnt]--;
 	}
+#ifdef EVENT_SCAN
+	if ( ++eventTicks >= EVENT_TICKS ) {
+		eventTicks = 0;
+		scanPending = true;
+	}
+#endif
+#ifdef SCANBUDGET
+	if ( scanning ) {
+		if ( !scanOverrun && ( tickCount - scanStart > SCANBUDGET ) ) {
+			scanOverrun = true;
+			overrunBlock = scanBlock;
+		}
+#ifdef FAILSAFE_OVERRUNS
+		// A runaway scan never gets to the accounting in execute(), so act from here
+		if ( !failSafeActive && ( tickCount - scanStart > (uint32_t)SCANBUDGET * FAILSAFE_OVERRUNS ) ) enterFailSafe();
+#endif
+	}
+#endif
 }
 
 // Debug help to list the bit variables (and timers). Not used during normal operation
 void listBits() {
-uint8_t cnt;
+uint16_t cnt;
 	for ( cnt = 0; cnt < BITSPACE; cnt++ ) {
 		if ( cnt % 8  == 0) Serial.println();
 		Serial.print(bits[cnt]);
@@ -48,7 +478,7 @@ uint8_t cnt;
 	Serial.println();
 }
 void listTimers() {
-	uint8_t cnt;
+	uint16_t cnt;
 	Serial.println(timerCount);
 	for ( cnt = 0; cnt < MAXTIMERS; cnt++ ) {
 		if ( cnt % 8  == 0) Serial.println();
@@ -58,6 +488,40 @@ void listTimers() {
 	Serial.println();
 }
 
+#ifdef SCANBUDGET
+void listScanStats() {
+	Serial.print("overruns ");
+	Serial.println(CList.overruns());
+	Serial.print("longest scan ");
+	Serial.print(CList.longestScan());
+	Serial.print(" ticks at block ");
+	Serial.println(CList.longestScanBlock());
+#ifdef FAILSAFE_OVERRUNS
+	if ( CList.failSafe() ) Serial.println("FAILSAFE");
+#endif
+}
+#endif
+
+// Debug help to compare the configured sizes with what the ladder really uses
+void listResources() {
+	Serial.print("bytes of bits ");
+	Serial.println(BITSPACE);
+	Serial.print("numerics ");
+	Serial.println(INTSPACE);
+	Serial.print("timers ");
+	Serial.print(timerCount);
+	Serial.print("/");
+	Serial.println(MAXTIMERS);
+	Serial.print("components ");
+	Serial.print(CList.index);
+	Serial.print("/");
+	Serial.println(MAXCOMPONENTS);
+#ifdef PLC_LADDER_FILE
+	Serial.print("ladder RAM ");			// without heap of Sequencers etc. and the library's globals, see plcRamBytes
+	Serial.println(plcRamBytes);
+#endif
+}
+
 // Helper function to extract a bit from the bitspace
 bool Bit(logicBit bit) {									// Bit interrogation routine
 	return bits[ bit / 8 ]	 & (1 << (bit % 8));
@@ -74,6 +538,18 @@ void setInt( uint8_t intIndex, int16_t Value ) {
 	ints[intIndex] = Value;
 }
 
+// Read element n of a PROGMEM table
+static uint16_t tableWord( const uint16_t *table, uint16_t n ) {
+	return pgm_read_word( table + n );
+}
+
+// Add two 32 bit values, saturating instead of overflowing
+static int32_t satAdd( int32_t a, int32_t b ) {
+	if ( b > 0 && a > INT32_MAX - b ) return INT32_MAX;
+	if ( b < 0 && a < INT32_MIN - b ) return INT32_MIN;
+	return a + b;
+}
+
 // PLC Component classes:
 //-------------------------
 // (for comments, see header "plc.h"
@@ -85,6 +561,7 @@ Component::Component(logicBit inPut, logicBit outPut) {
 	inBit = inPut;
 	outBit = outPut;
 	state = state_OFF;
+	prevInput = false;
 	CList.add(this);
 }
 
@@ -92,6 +569,18 @@ void Component::execute() {
 
 }
 
+uint16_t Component::frameSize() { return 1; }
+
+// state and prevInput are packed in one byte
+void Component::saveFrame(uint8_t *frame) {
+	*frame = state | ( prevInput << 2 );
+}
+
+void Component::loadFrame(const uint8_t *frame) {
+	state = (lState)( *frame & 0x03 );
+	prevInput = *frame & 0x04;
+}
+
 
 
 Logic2::Logic2(logicBit inPut, logicBit inPut2, logicBit outPut, logicFunction func):Component(inPut, outPut) {
@@ -273,6 +762,18 @@ DnCounter::DnCounter(logicBit clock, logicBit reset, logicBit outPut, uint16_t i
 	prevInput = false;
 }
 
+uint16_t DnCounter::frameSize() { return 3; }
+
+void DnCounter::saveFrame(uint8_t *frame) {
+	Component::saveFrame(frame);
+	memcpy( frame + 1, &count, 2 );
+}
+
+void DnCounter::loadFrame(const uint8_t *frame) {
+	Component::loadFrame(frame);
+	memcpy( &count, frame + 1, 2 );
+}
+
 void DnCounter::execute() {
 bool tmpBit;
 	tmpBit = Bit(inBit);
@@ -293,7 +794,6 @@ bool tmpBit;
 
 UpCounter::UpCounter(logicBit clock, logicBit reset, numeric outPut):Component(clock, outPut) {
 	inBit2 = reset;
-	ints[outBit] = 0;
 	prevInput = false;
 }
 
@@ -495,6 +995,167 @@ tmpVal_u tmpVal;
 	ints[outBit] = tmpVal.s[1];
 }
 
+Linearize::Linearize(numeric inPut, numeric outPut, const uint16_t *table, uint8_t points):Component(inPut, outPut) {
+	tbl = table;
+	nPoints = points;
+}
+
+void Linearize::execute() {
+uint16_t x, x0, x1, y0, y1;
+uint8_t lo, hi, mid;
+	x = ints[inBit];
+	if ( x <= tableWord( tbl, 0 ) ) {
+		ints[outBit] = tableWord( tbl, 1 );
+		return;
+	}
+	if ( x >= tableWord( tbl, 2 * ( nPoints - 1 ) ) ) {
+		ints[outBit] = tableWord( tbl, 2 * nPoints - 1 );
+		return;
+	}
+	lo = 0;					// invariant: x(lo) < x < x(hi)
+	hi = nPoints - 1;
+	while ( hi - lo > 1 ) {
+		mid = ( lo + hi ) / 2;
+		if ( x < tableWord( tbl, 2 * mid ) ) hi = mid;
+		else lo = mid;
+	}
+	x0 = tableWord( tbl, 2 * lo );
+	x1 = tableWord( tbl, 2 * hi );
+	y0 = tableWord( tbl, 2 * lo + 1 );
+	y1 = tableWord( tbl, 2 * hi + 1 );
+	// the product of two 16 bit differences needs all 32 bits, so keep it unsigned
+	if ( y1 >= y0 ) ints[outBit] = y0 + (uint32_t)( y1 - y0 ) * ( x - x0 ) / ( x1 - x0 );
+	else ints[outBit] = y0 - (uint32_t)( y0 - y1 ) * ( x - x0 ) / ( x1 - x0 );
+}
+
+PID::PID(logicBit enable, numeric setPoint, numeric processValue, numeric outPut, float Kp, float Ki, float Kd, uint16_t period, uint16_t outMin, uint16_t outMax):Component(enable, outPut) {
+	spIndex = setPoint;
+	pvIndex = processValue;
+	kP = Kp * 256;
+	kI = Ki * 256;
+	kD = Kd * 256;
+	sampleTime = period;
+	minOut = outMin;
+	maxOut = outMax;
+	integral = 0;
+	prevPv = 0;
+	nextSample = 0;
+}
+
+// All terms are kept in 8.8 fixed point. A 17 bit error times a 15 bit gain just fits in 32 bits.
+// The next evaluation is due sampleTime ticks after this one was due, not after it was made.
+void PID::execute() {
+uint32_t now;
+int32_t err, pTerm, dTerm, out;
+uint16_t pv;
+	if ( !Bit(inBit) ) {
+		ints[outBit] = minOut;
+		integral = (int32_t)minOut << 8;
+		state = state_OFF;
+		return;
+	}
+	pv = ints[pvIndex];
+	cli();
+	now = tickCount;
+	sei();
+	if ( state == state_OFF ) {	// just enabled, start from the current process value
+		prevPv = pv;
+		state = state_ON;
+		nextSample = now;
+	}
+	if ( (int32_t)( now - nextSample ) < 0 ) return;
+	nextSample += sampleTime;
+	if ( (int32_t)( now - nextSample ) >= 0 ) nextSample = now + sampleTime;	// a whole period missed
+	err = (int32_t)ints[spIndex] - pv;
+	pTerm = err * kP;
+	dTerm = ( (int32_t)pv - prevPv ) * kD;
+	prevPv = pv;
+	integral = satAdd( integral, err * kI );
+	if ( integral > (int32_t)maxOut << 8 ) integral = (int32_t)maxOut << 8;
+	if ( integral < (int32_t)minOut << 8 ) integral = (int32_t)minOut << 8;
+	out = satAdd( satAdd( pTerm, integral ), -dTerm ) >> 8;
+	if ( out > maxOut ) out = maxOut;
+	if ( out < minOut ) out = minOut;
+	ints[outBit] = out;
+}
+
+uint16_t PID::frameSize() { return 11; }
+
+// The schedule is saved relative to frameTime, so a restored PID evaluates as many ticks after the
+// restore as it would have after the snapshot
+void PID::saveFrame(uint8_t *frame) {
+uint32_t due;
+	Component::saveFrame(frame);
+	due = nextSample - frameTime;
+	memcpy( frame + 1, &integral, 4 );
+	memcpy( frame + 5, &prevPv, 2 );
+	memcpy( frame + 7, &due, 4 );
+}
+
+void PID::loadFrame(const uint8_t *frame) {
+uint32_t due;
+	Component::loadFrame(frame);
+	memcpy( &integral, frame + 1, 4 );
+	memcpy( &prevPv, frame + 5, 2 );
+	memcpy( &due, frame + 7, 4 );
+	nextSample = frameTime + due;
+}
+
+Ramp::Ramp(numeric inPut, numeric outPut, uint16_t step, uint16_t period, uint16_t outMin, uint16_t outMax):Component(inPut, outPut) {
+	maxStep = step;
+	stepTime = period;
+	minOut = outMin;
+	maxOut = outMax;
+	timerIndex = timerCount++;
+}
+
+void Ramp::execute() {
+uint32_t tmpTimer;
+uint16_t target, out;
+	cli();
+	tmpTimer = timers[timerIndex];
+	sei();
+	if ( tmpTimer != 0 ) return;
+	target = ints[inBit];
+	if ( target > maxOut ) target = maxOut;
+	if ( target < minOut ) target = minOut;
+	out = ints[outBit];
+	if ( out == target ) return;
+	if ( target > out ) out = ( target - out > maxStep ) ? out + maxStep : target;
+	else out = ( out - target > maxStep ) ? out - maxStep : target;
+	ints[outBit] = out;
+	cli();
+	timers[timerIndex] = stepTime;
+	sei();
+}
+
+// The scaling to the PWM resolution is a 16.16 multiplier precomputed here. It is rounded up
+// so that fullScale gives exactly the full duty (and never more, as fullScale * mul < (top + 1) << 16)
+PWMOut::PWMOut(numeric inPut, uint8_t pin, uint16_t fullScale):Component(inPut, pin) {
+	maxIn = fullScale;
+	duty = 0;
+	pinMode(pin, OUTPUT);
+	if ( pin == 9 || pin == 10 ) {
+		mul = ( ( 1023UL << 16 ) + fullScale - 1 ) / fullScale;
+		Timer1.pwm(pin, 0);
+	}
+	else {
+		mul = ( ( 255UL << 16 ) + fullScale - 1 ) / fullScale;
+		analogWrite(pin, 0);
+	}
+}
+
+void PWMOut::execute() {
+uint16_t val;
+	val = ints[inBit];
+	if ( val > maxIn ) val = maxIn;
+	val = ( val * mul ) >> 16;
+	if ( val == duty ) return;
+	duty = val;
+	if ( outBit == 9 || outBit == 10 ) Timer1.setPwmDuty(outBit, duty);
+	else analogWrite(outBit, duty);
+}
+
 CompareNumeric::CompareNumeric(numeric inPut1, numeric inPut2, logicBit outPut, compareOp cmp):Component(inPut1, outPut) {
 	inNum2 = inPut2;
 	comp = cmp;
@@ -511,10 +1172,289 @@ void CompareNumeric::execute() {
 	}
 }
 
+Sequencer::Sequencer(logicBit reset, logicBit firstStepBit, uint8_t steps, uint8_t transitions, uint8_t initialStep):Component(reset, firstStepBit) {
+uint8_t cnt;
+bool active = false;
+	nSteps = steps;
+	maxTrans = transitions;
+	nTrans = 0;
+	initStep = initialStep;
+	firstOut = new uint8_t[nSteps];
+	stepTimer = new uint8_t[nSteps];
+	fire = new uint8_t[( maxTrans + 7 ) / 8];
+	trans = new SeqTransition[maxTrans];
+	for ( cnt = 0; cnt < nSteps; cnt++ ) {
+		firstOut[cnt] = NOSTEP;
+		stepTimer[cnt] = NOSTEP;
+		if ( Bit( outBit + cnt ) ) active = true;
+	}
+	if ( !active ) activate( initStep );
+}
 
-void ComponentList::begin() {
+// Returns the index of the new transition, NOSTEP if there is no room or no timer left for a timed step
+uint8_t Sequencer::transition(uint8_t from, uint8_t to, logicBit condition, uint32_t time) {
+uint8_t t, *link;
+	if ( nTrans >= maxTrans ) return NOSTEP;
+	if ( time && stepTimer[from] == NOSTEP && timerCount >= MAXTIMERS ) return NOSTEP;
+	t = nTrans++;
+	trans[t].from = from;
+	trans[t].from2 = NOSTEP;
+	trans[t].to = to;
+	trans[t].to2 = NOSTEP;
+	trans[t].cond = condition;
+	trans[t].time = time;
+	trans[t].next = NOSTEP;
+	for ( link = &firstOut[from]; *link != NOSTEP; link = &trans[*link].next );	// append, first added wins
+	*link = t;
+	if ( time && stepTimer[from] == NOSTEP ) {
+		stepTimer[from] = timerCount++;
+		if ( Bit( outBit + from ) ) activate( from );	// (re)start the timer if the step is already active
+	}
+	return t;
+}
+
+void Sequencer::branch(uint8_t to2) {
+	if ( nTrans ) trans[nTrans - 1].to2 = to2;
+}
+
+void Sequencer::join(uint8_t from2) {
+	if ( nTrans ) trans[nTrans - 1].from2 = from2;
+}
+
+// The step timer is loaded with the maximum and counts down, so the time a step
+// has been active is UINT32_MAX - timer regardless of how many timed transitions leave it
+void Sequencer::activate(uint8_t step) {
+	setBit( outBit + step, true );
+	if ( stepTimer[step] != NOSTEP ) {
+		cli();
+		timers[stepTimer[step]] = UINT32_MAX;
+		sei();
+	}
+}
+
+bool Sequencer::ready(uint8_t t) {
+uint32_t tmpTimer;
+	if ( !Bit( trans[t].cond ) ) return false;
+	if ( trans[t].from2 != NOSTEP && !Bit( outBit + trans[t].from2 ) ) return false;
+	if ( trans[t].time ) {
+		cli();
+		tmpTimer = timers[stepTimer[trans[t].from]];
+		sei();
+		if ( UINT32_MAX - tmpTimer < trans[t].time ) return false;
+	}
+	return true;
+}
+
+// First find the transitions to fire going through the active steps only (zero bytes are skipped),
+// then fire them, so that no step advances twice on the same scan.
+// Step bits that do not start on a byte boundary are shifted into place a byte at a time
+void Sequencer::execute() {
+uint8_t byteCnt, bitCnt, act, step, t, shift;
+uint16_t byteIndex;
+bool anyFire = false;
+	if ( Bit( inBit ) ) {
+		for ( step = 0; step < nSteps; step++ ) setBit( outBit + step, false );
+		activate( initStep );
+		return;
+	}
+	for ( byteCnt = 0; byteCnt < ( maxTrans + 7 ) / 8; byteCnt++ ) fire[byteCnt] = 0;
+	shift = outBit % 8;
+	for ( byteCnt = 0; byteCnt < ( nSteps + 7 ) / 8; byteCnt++ ) {
+		byteIndex = outBit / 8 + byteCnt;
+		act = bits[byteIndex] >> shift;
+		if ( shift && byteIndex + 1 < BITSPACE ) act |= bits[byteIndex + 1] << ( 8 - shift );
+		for ( bitCnt = 0; act; bitCnt++, act >>= 1 ) {
+			if ( !( act & 1 ) ) continue;
+			step = byteCnt * 8 + bitCnt;
+			if ( step >= nSteps ) break;
+			for ( t = firstOut[step]; t != NOSTEP; t = trans[t].next ) {
+				if ( ready( t ) ) {
+					fire[t / 8] |= 1 << ( t % 8 );
+					anyFire = true;
+					break;
+				}
+			}
+		}
+	}
+	if ( !anyFire ) return;
+	for ( t = 0; t < nTrans; t++ ) {
+		if ( !( fire[t / 8] & ( 1 << ( t % 8 ) ) ) ) continue;
+		setBit( outBit + trans[t].from, false );
+		if ( trans[t].from2 != NOSTEP ) setBit( outBit + trans[t].from2, false );
+		activate( trans[t].to );
+		if ( trans[t].to2 != NOSTEP ) activate( trans[t].to2 );
+	}
+}
+
+FunctionBlock::FunctionBlock(uint8_t bitWindow, uint8_t bitBytes, uint8_t bitIn, uint8_t bitOut, numeric intWindow, uint8_t intCount, uint8_t intIn, uint8_t intOut, uint8_t maxInstances):Component(0, 0) {
+	winBits = bitWindow;
+	nBitBytes = bitBytes;
+	nBitIn = bitIn;
+	nBitIO = bitIn + bitOut;
+	winInts = intWindow;
+	nInts = intCount;
+	nIntIn = intIn;
+	nIntIO = intIn + intOut;
+	maxInst = maxInstances;
+	nInst = 0;
+	nBody = 0;
+	nTimers = 0;
+	body = NULL;
+	frames = NULL;
+	timeBase = 0;
+}
+
+// Remember where the body starts in the component list and the timer space
+void FunctionBlock::define() {
+	nBody = CList.index;
+	firstTimer = timerCount;
+}
+
+// Move the body components out of the component list into the block and allocate the frames.
+// Frame layout: [timer base][bit bindings][int bindings][local bit bytes][local numerics][component states]
+void FunctionBlock::endDefine() {
 uint8_t cnt;
+uint16_t stateOffset, stateBytes;
+uint8_t *frame;
+	body = new Component *[CList.index - nBody];
+	for ( cnt = nBody; cnt < CList.index; cnt++ ) body[cnt - nBody] = CList.list[cnt];
+	cnt = nBody;
+	nBody = CList.index - nBody;
+	CList.index = cnt;
+	nTimers = timerCount - firstTimer;
+	stateOffset = 1 + nBitIO * sizeof(logicBit) + nIntIO * sizeof(numeric) + nBitBytes + nInts * sizeof(uint16_t);
+	stateBytes = 0;
+	for ( cnt = 0; cnt < nBody; cnt++ ) stateBytes += body[cnt]->frameSize();
+	frameBytes = stateOffset + stateBytes;
+	frames = new uint8_t[maxInst * frameBytes];
+	memset( frames, 0, maxInst * frameBytes );
+	// every instance starts from the state the body components were created in
+	frameTime = timeBase;
+	frame = frames + stateOffset;
+	for ( cnt = 0; cnt < nBody; cnt++ ) {
+		body[cnt]->saveFrame(frame);
+		frame += body[cnt]->frameSize();
+	}
+	for ( cnt = 1; cnt < maxInst; cnt++ ) memcpy( frames + cnt * frameBytes + stateOffset, frames + stateOffset, stateBytes );
+}
+
+// The first instance runs on the timers of the body itself, every other one gets nTimers timers of its own.
+// Returns false if there is no room for another instance or no timers left for it
+bool FunctionBlock::instance(const logicBit *bitBinding, const numeric *intBinding) {
+uint8_t *frame;
+	if ( nInst >= maxInst ) return false;
+	if ( nInst && timerCount + nTimers > MAXTIMERS ) return false;
+	frame = frames + nInst * frameBytes;
+	if ( nInst ) {
+		frame[0] = timerCount;
+		timerCount += nTimers;
+	}
+	else frame[0] = firstTimer;
+	memcpy( frame + 1, bitBinding, nBitIO * sizeof(logicBit) );
+	memcpy( frame + 1 + nBitIO * sizeof(logicBit), intBinding, nIntIO * sizeof(numeric) );
+	nInst++;
+	return true;
+}
+
+// The bindings in a frame are not aligned, so they are copied out byte by byte
+logicBit FunctionBlock::bitBinding(const uint8_t *frame, uint8_t param) {
+logicBit bit;
+	memcpy( &bit, frame + 1 + param * sizeof(logicBit), sizeof(logicBit) );
+	return bit;
+}
+
+numeric FunctionBlock::intBinding(const uint8_t *frame, uint8_t param) {
+numeric index;
+	memcpy( &index, frame + 1 + nBitIO * sizeof(logicBit) + param * sizeof(numeric), sizeof(numeric) );
+	return index;
+}
+
+// Exchange the window timers with the timers of an instance. Both sets keep ticking in the ISR
+void FunctionBlock::swapTimers(uint8_t base) {
+uint8_t cnt;
+uint32_t tmpTimer;
+	if ( base == firstTimer ) return;				// the first instance
+	cli();
+	for ( cnt = 0; cnt < nTimers; cnt++ ) {
+		tmpTimer = timers[firstTimer + cnt];
+		timers[firstTimer + cnt] = timers[base + cnt];
+		timers[base + cnt] = tmpTimer;
+	}
+	sei();
+}
+
+// Bring an instance in: copy its local bits, numerics and component states into the window and the body
+void FunctionBlock::load(const uint8_t *frame) {
+uint8_t cnt;
+	swapTimers( frame[0] );
+	frame += 1 + nBitIO * sizeof(logicBit) + nIntIO * sizeof(numeric);
+	memcpy( &bits[winBits], frame, nBitBytes );
+	frame += nBitBytes;
+	memcpy( &ints[winInts], frame, nInts * sizeof(uint16_t) );
+	frame += nInts * sizeof(uint16_t);
+	frameTime = timeBase;
+	for ( cnt = 0; cnt < nBody; cnt++ ) {
+		body[cnt]->loadFrame(frame);
+		frame += body[cnt]->frameSize();
+	}
+}
+
+// Take an instance out again
+void FunctionBlock::store(uint8_t *frame) {
+uint8_t cnt;
+	swapTimers( frame[0] );
+	frame += 1 + nBitIO * sizeof(logicBit) + nIntIO * sizeof(numeric);
+	memcpy( frame, &bits[winBits], nBitBytes );
+	frame += nBitBytes;
+	memcpy( frame, &ints[winInts], nInts * sizeof(uint16_t) );
+	frame += nInts * sizeof(uint16_t);
+	frameTime = timeBase;
+	for ( cnt = 0; cnt < nBody; cnt++ ) {
+		body[cnt]->saveFrame(frame);
+		frame += body[cnt]->frameSize();
+	}
+}
+
+// The state of a function block is the frames of all its instances. Times in them stay relative to
+// timeBase, which moves with the snapshot: [timeBase - frameTime][frames]
+uint16_t FunctionBlock::frameSize() { return 4 + nInst * frameBytes; }
+
+void FunctionBlock::saveFrame(uint8_t *frame) {
+uint32_t base;
+	base = timeBase - frameTime;
+	memcpy( frame, &base, 4 );
+	memcpy( frame + 4, frames, nInst * frameBytes );
+}
+
+void FunctionBlock::loadFrame(const uint8_t *frame) {
+uint32_t base;
+	memcpy( &base, frame, 4 );
+	timeBase = frameTime + base;
+	memcpy( frames, frame + 4, nInst * frameBytes );
+}
+
+void FunctionBlock::execute() {
+uint8_t inst, cnt;
+uint8_t *frame;
+	for ( inst = 0, frame = frames; inst < nInst; inst++, frame += frameBytes ) {
+		load(frame);
+		for ( cnt = 0; cnt < nBitIn; cnt++ ) setBit( winBits * 8 + cnt, Bit( bitBinding( frame, cnt ) ) );
+		for ( cnt = 0; cnt < nIntIn; cnt++ ) ints[winInts + cnt] = ints[intBinding( frame, cnt )];
+		for ( cnt = 0; cnt < nBody; cnt++ ) body[cnt]->execute();
+		for ( cnt = nBitIn; cnt < nBitIO; cnt++ ) setBit( bitBinding( frame, cnt ), Bit( winBits * 8 + cnt ) );
+		for ( cnt = nIntIn; cnt < nIntIO; cnt++ ) ints[intBinding( frame, cnt )] = ints[winInts + cnt];
+		store(frame);
+	}
+}
+
+
+void ComponentList::begin() {
+uint16_t cnt;
 	index = 0;
+#ifdef FAILSAFE_OVERRUNS
+	MCUSR = 0;			// the watchdog stays on after a watchdog reset unless WDRF is cleared first
+	wdt_disable();
+#endif
 	pinMode(OE, OUTPUT);
 	pinMode(STROBE, OUTPUT);
 	digitalWrite(STROBE, HIGH);
@@ -525,8 +1465,16 @@ uint8_t cnt;
 	digitalWrite(OE, LOW);
 	Timer1.initialize(TIMERTICK);
 	Timer1.attachInterrupt(tISR);
+#ifdef EVENT_SCAN
+	pinMode(EVENT_PIN, INPUT_PULLUP);
+	attachInterrupt(digitalPinToInterrupt(EVENT_PIN), eISR, CHANGE);
+	set_sleep_mode(SLEEP_MODE_IDLE);
+#endif
 	for ( cnt = 0; cnt < BITSPACE; cnt++) bits[cnt] = 0;
 	for ( cnt = 0; cnt < INTSPACE; cnt++) ints[cnt] = 0;
+#ifdef RETENTIVE
+	retainLoad();
+#endif
 }
 
 bool ComponentList::add( Component *component ) {
@@ -540,19 +1488,282 @@ bool ComponentList::add( Component *component ) {
 void ComponentList::execute() {
 uint8_t cnt;
 uint16_t tmpint;
-	digitalWrite(STROBE, LOW);
-	digitalWrite(STROBE, HIGH);
-	tmpint = bits[2] | (bits[3]<<8);
-	tmpint = SPI.transfer16(tmpint);
+#ifdef SCANBUDGET
+uint32_t tmpTicks;
+#endif
+	tmpint = transferIO(outputImage());
 #ifdef INVERT_INPUTS
 	tmpint = ~tmpint;
 #endif
-	digitalWrite(OE, HIGH);
-	digitalWrite(OE, LOW);
 	bits[0] = tmpint & 0xff;
 	bits[1] = tmpint >> 8;
+#ifdef I2CLINK
+	linkReceive();
+#endif
+#ifdef SCANBUDGET
+	cli();
+	scanStart = tickCount;
+	scanOverrun = false;
+	scanBlock = 0;
+	scanning = true;
+	sei();
+#endif
 	for ( cnt = 0; cnt < index; cnt++ ) {
+#ifdef SCANBUDGET
+		scanBlock = cnt;
+#endif
 		list[cnt]->execute();
 	}
+#ifdef RETENTIVE
+	retainService();
+#endif
+#ifdef I2CLINK
+	linkService();
+#endif
+#ifdef SCANBUDGET
+	cli();
+	scanning = false;
+	tmpTicks = tickCount - scanStart;
+	sei();
+	if ( tmpTicks > maxScanTicks ) {
+		maxScanTicks = tmpTicks;
+		maxScanBlock = scanOverrun ? overrunBlock : NOBLOCK;
+	}
+	if ( scanOverrun ) {
+		if ( overrunCount < UINT16_MAX ) overrunCount++;
+#ifdef FAILSAFE_OVERRUNS
+		if ( consecutiveOverruns < FAILSAFE_OVERRUNS ) consecutiveOverruns++;
+		if ( !failSafeActive && consecutiveOverruns >= FAILSAFE_OVERRUNS ) enterFailSafe();
+#endif
+	}
+#ifdef FAILSAFE_OVERRUNS
+	else consecutiveOverruns = 0;
+#endif
+#ifdef FAILSAFE_OVERRUNS
+	if ( failSafeActive ) wdt_reset();
+#endif
+#endif
+}
+
+// Wait for a scan request, idling the processor in the meantime, then execute the scan.
+// Interrupts are disabled between the check and sleep_cpu() (sei takes effect one instruction late)
+// so a request arriving in between cannot be missed.
+// The outputs are clocked out again right after the scan, so an event is latched, solved and
+// output in one pass instead of waiting for the start of the next scan.
+void ComponentList::run() {
+#ifdef EVENT_SCAN
+	cli();
+	while ( !scanPending ) {
+		sleep_enable();
+		sei();
+		sleep_cpu();
+		sleep_disable();
+		cli();
+	}
+	scanPending = false;
+	sei();
+#endif
+	execute();
+#ifdef EVENT_SCAN
+	transferIO(outputImage());
+#endif
 }
 
+// Debug help to time the ladder on the target. Not used during normal operation.
+// Each component is executed 'rounds' times back to back and its average execution time is
+// printed as a line "index,nanoseconds" (index is the creation order), followed by the timer
+// interrupt "isr,<timerCount>,nanoseconds" and a scan (I/O transfer and all components) "scan,<components>,nanoseconds".
+// Any result above 'limit' nanoseconds gets ",SLOW" appended and makes the call return false (limit 0 = no limit).
+// The ladder is left as it was found: the run time state is snapshot before and restored after,
+// the extra ticks of the timed interrupt calls are taken back and the scan does no EEPROM checkpoint,
+// link traffic or scan monitor accounting. The timers stand still for the duration of the call.
+// Returns false without timing anything if there is no heap for the snapshot.
+// The regression suite with a baseline is the host benchmark in host/bench.cpp.
+bool ComponentList::profile( uint16_t rounds, uint32_t limit ) {
+uint8_t cnt, blk;
+uint16_t rnd;
+uint32_t tmpTime;
+uint8_t *saved;
+bool ok = true;
+#ifdef EVENT_SCAN
+bool savedPending;
+uint8_t savedEventTicks;
+#endif
+	if ( rounds == 0 ) return true;
+	saved = new uint8_t[snapshotSize()];
+	if ( saved == NULL ) return false;
+	snapshot( saved );
+	for ( cnt = 0; cnt <= index + 1; cnt++ ) {
+		tmpTime = micros();
+		if ( cnt < index ) {
+			for ( rnd = 0; rnd < rounds; rnd++ ) list[cnt]->execute();
+		}
+		else if ( cnt == index ) {
+#ifdef EVENT_SCAN
+			cli();
+			savedPending = scanPending;
+			savedEventTicks = eventTicks;
+			sei();
+#endif
+			for ( rnd = 0; rnd < rounds; rnd++ ) {
+				cli();
+				tISR();
+				sei();
+			}
+			cli();
+			tickCount -= rounds;
+#ifdef EVENT_SCAN
+			scanPending = savedPending;
+			eventTicks = savedEventTicks;
+#endif
+			sei();
+		}
+		else {
+			for ( rnd = 0; rnd < rounds; rnd++ ) {
+				transferIO( outputImage() );
+				for ( blk = 0; blk < index; blk++ ) list[blk]->execute();
+			}
+		}
+		tmpTime = (uint64_t)(micros() - tmpTime) * 1000 / rounds;
+		if ( cnt < index ) Serial.print(cnt);
+		else {
+			Serial.print( cnt == index ? "isr," : "scan," );
+			Serial.print( cnt == index ? timerCount : index );
+		}
+		Serial.print(",");
+		Serial.print(tmpTime);
+		if ( limit && tmpTime > limit ) {
+			Serial.print(",SLOW");
+			ok = false;
+		}
+		Serial.println();
+	}
+	restore( saved );
+	delete[] saved;
+	return ok;
+}
+
+// Snapshot layout: [timerCount][bits][ints][timers][state of each component in list order]
+// Times in the component states are relative to the tick of the snapshot (frameTime), so a
+// restore goes on from the same point whenever it is made
+uint16_t ComponentList::snapshotSize() {
+uint16_t size;
+uint8_t cnt;
+	size = 1 + sizeof(bits) + sizeof(ints) + sizeof(timers);
+	for ( cnt = 0; cnt < index; cnt++ ) size += list[cnt]->frameSize();
+	return size;
+}
+
+void ComponentList::snapshot(uint8_t *blob) {
+uint8_t cnt;
+	*blob++ = timerCount;
+	memcpy( blob, bits, sizeof(bits) );
+	blob += sizeof(bits);
+	memcpy( blob, ints, sizeof(ints) );
+	blob += sizeof(ints);
+	cli();
+	memcpy( blob, (const void *)timers, sizeof(timers) );
+	frameTime = tickCount;
+	sei();
+	blob += sizeof(timers);
+	for ( cnt = 0; cnt < index; cnt++ ) {
+		list[cnt]->saveFrame(blob);
+		blob += list[cnt]->frameSize();
+	}
+}
+
+void ComponentList::restore(const uint8_t *blob) {
+uint8_t cnt;
+	timerCount = *blob++;
+	memcpy( bits, blob, sizeof(bits) );
+	blob += sizeof(bits);
+	memcpy( ints, blob, sizeof(ints) );
+	blob += sizeof(ints);
+	cli();
+	memcpy( (void *)timers, blob, sizeof(timers) );
+	frameTime = tickCount;
+	sei();
+	blob += sizeof(timers);
+	for ( cnt = 0; cnt < index; cnt++ ) {
+		list[cnt]->loadFrame(blob);
+		blob += list[cnt]->frameSize();
+	}
+}
+
+#ifdef RETENTIVE
+uint32_t ComponentList::retainWrites() { return retainWriteCount; }
+#endif
+
+#ifdef I2CLINK
+// Set up the TWI hardware as a general call receiver and start publishing. Called again, the link
+// starts afresh: nothing pending, nothing received, everything published is sent once
+void ComponentList::linkBegin( uint8_t node, logicBit bitFirst, logicBit bitLast, numeric intFirst, numeric intLast ) {
+uint16_t cnt;
+	TWCR = 0;
+	linkBitByte = bitFirst / 8;
+	linkBitBytes = bitLast / 8 - bitFirst / 8 + 1;
+	linkInt = intFirst;
+	linkIntBytes = 2 * ( intLast - intFirst + 1 );
+	delete[] linkShadow;
+	linkShadow = new uint8_t[linkBitBytes + linkIntBytes];
+	linkCursor = 0;
+	linkRefreshCursor = 0;
+	linkTxBusy = false;
+	linkTxOk = false;
+	linkTxErrorCount = 0;
+	linkTxShare = 0;
+	linkRxHead = linkRxTail = 0;
+	cli();
+	linkLastRefresh = tickCount;
+	sei();
+	for ( cnt = 0; cnt < linkBitBytes + linkIntBytes; cnt++ ) linkShadow[cnt] = ~*linkByte( cnt );	// everything is sent once
+	for ( cnt = 0; cnt < LINK_NODES; cnt++ ) {
+		linkSeen[cnt] = UINT32_MAX;
+		linkErrorCount[cnt] = 0;
+	}
+	TWSR = 0;
+	TWBR = ( F_CPU / LINK_CLOCK - 16 ) / 2;
+	TWAR = ( ( node + 8 ) << 1 ) | _BV(TWGCE);
+	TWCR = TWI_ACK;
+	linkNode = node;
+}
+
+uint32_t ComponentList::linkAge( uint8_t node ) {
+uint32_t tmpTicks;
+	if ( node >= LINK_NODES || linkSeen[node] == UINT32_MAX ) return UINT32_MAX;
+	cli();
+	tmpTicks = tickCount;
+	sei();
+	return tmpTicks - linkSeen[node];
+}
+
+uint16_t ComponentList::linkErrors( uint8_t node ) { return node < LINK_NODES ? linkErrorCount[node] : 0; }
+
+uint16_t ComponentList::linkTxErrors() { return linkTxErrorCount; }
+#endif
+
+#ifdef SCANBUDGET
+uint16_t ComponentList::overruns() { return overrunCount; }
+
+uint32_t ComponentList::longestScan() { return maxScanTicks; }
+
+uint8_t ComponentList::longestScanBlock() { return maxScanBlock; }
+
+void ComponentList::clearScanStats() {
+	overrunCount = 0;
+	maxScanTicks = 0;
+	maxScanBlock = NOBLOCK;
+}
+
+#ifdef FAILSAFE_OVERRUNS
+bool ComponentList::failSafe() { return failSafeActive; }
+
+// Release the outputs back to the ladder. The watchdog is disarmed as well.
+void ComponentList::clearFailSafe() {
+	wdt_disable();
+	consecutiveOverruns = 0;
+	failSafeActive = false;
+}
+#endif
+#endif
+
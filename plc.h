@@ -26,7 +26,21 @@ enum logicFunction {AND, NAND, OR, NOR, XOR};		// functions the Logic2 component
 enum numericFunction {PLUS, MINUS, MUL, DIV, MOD};	// functions the Calc2 component knows how to do
 enum compareOp {LT, LE, EQ, GE, GT};				// functions the numeric compare knows how to do
 
+#define NOBLOCK 0xFF								// "no component" marker returned by the scan monitor
+#define NOSTEP 0xFF									// "no step" marker of the Sequencer
+
+#ifdef RETENTIVE
+// Size of one RETENTIVE checkpoint slot in EEPROM. The slots fill the EEPROM from RETAIN_EEPROM_BASE up
+#define RETAIN_BITBYTES (RETAIN_BIT_LAST/8 - RETAIN_BIT_FIRST/8 + 1)
+#define RETAIN_SIZE (RETAIN_BITBYTES + 2 * (RETAIN_INT_LAST - RETAIN_INT_FIRST + 1))
+#define RETAIN_SLOTSIZE (RETAIN_SIZE + 2)
+#define RETAIN_SLOTS ((E2END + 1 - RETAIN_EEPROM_BASE) / RETAIN_SLOTSIZE)
+#endif
+
 void tISR();										// Timer 1 interrupt routine declaration
+#ifdef EVENT_SCAN
+void eISR();										// Event pin interrupt routine declaration
+#endif
 
 bool Bit(logicBit bit);								// Bit interrogation 
 void setBit( logicBit bit, bool state );			// Bit set/reset routine
@@ -36,20 +50,35 @@ void setInt( uint8_t intIndex, int16_t Value );		// Integer set routine
 
 void listBits();									// Debug help to list bit space (as hex so you need to decode that in your head)
 void listTimers();									// Debug help to list timers
+void listResources();								// Debug help to list the configured vs used resources
+#ifdef SCANBUDGET
+void listScanStats();								// Debug help to list the scan monitor counters
+#endif
 
 class ComponentList;								// Advance declaration of Component iterator class
+class FunctionBlock;								// Advance declaration of the subroutine component
 
 // Base class of all ladder logic components.
 // Every real component is derived from this class
 // Do NOT attempt to create instances of this class
+// The run time state of a component (state and prevInput by default) can be copied to and from
+// a frame buffer: frameSize() tells how many bytes it takes, saveFrame() and loadFrame() copy it.
+// A component that keeps more state of its own must override all three. A tick count in a frame is
+// saved relative to frameTime and made absolute again on load (see PID), so that a restored
+// state carries on the same however much later it is restored.
 class Component {
 	friend class ComponentList;
+	friend class FunctionBlock;
 public:
 	Component(logicBit inPut, logicBit outPut);
 protected:
 	logicBit inBit, outBit;
 	virtual void execute();
+	virtual uint16_t frameSize();
+	virtual void saveFrame(uint8_t *frame);
+	virtual void loadFrame(const uint8_t *frame);
 	lState state;
+	bool prevInput;
 };
 
 // Not: Inverts the input bit.
@@ -106,7 +135,6 @@ public:
 private:
 	uint32_t onTime, offTime;
 	uint8_t timerIndex;
-	bool prevInput;
 	void execute();
 };
 
@@ -118,7 +146,6 @@ public:
 private:
 	uint32_t setTime;
 	uint8_t timerIndex;
-	bool prevInput;
 	void execute();
 };
 
@@ -130,7 +157,6 @@ public:
 private:
 	uint8_t setTimeIndex;
 	uint8_t timerIndex;
-	bool prevInput;
 	void execute();
 };
 
@@ -145,8 +171,10 @@ private:
 	logicBit inBit2;
 	uint8_t initialCount;
 	uint16_t count;
-	bool prevInput;
 	void execute();
+	uint16_t frameSize();
+	void saveFrame(uint8_t *frame);
+	void loadFrame(const uint8_t *frame);
 };
 
 // UpCounter: Up counter. Counts positive clock edges from 0 upwards.
@@ -160,7 +188,6 @@ public:
 private:
 	logicBit inBit2;
 	numeric countIndex;
-	bool prevInput;
 	void execute();
 };
 
@@ -177,7 +204,6 @@ private:
 	uint32_t setTime_d;
 	uint32_t setTime_t;
 	uint8_t timerIndex;
-	bool prevInput;
 	void execute();
 
 };
@@ -192,7 +218,6 @@ private:
 	uint8_t setTime_dIndex;
 	uint8_t setTime_tIndex;
 	uint8_t timerIndex;
-	bool prevInput;
 	void execute();
 
 };
@@ -263,16 +288,213 @@ private:
 	void execute();
 };
 
+// Linearize: Converts a numeric through a piecewise linear table stored in flash (PROGMEM).
+// The table is 'points' pairs of { x, y } unsigned 16 bit values with x in ascending order, e.g.
+//   const uint16_t ntcTable[] PROGMEM = { 100, 1200,  400, 650,  900, 250 };
+//   new Linearize( 1, 2, ntcTable, 3 );
+// The segment is found by binary search and the output is interpolated linearly with integer math.
+// Inputs below the first or above the last x give the first or last y.
+// host/lintable.cpp makes the table from a sensor curve and reports the approximation error.
+class Linearize: public Component {
+public:
+	Linearize(numeric inPut, numeric outPut, const uint16_t *table, uint8_t points);
+private:
+	const uint16_t *tbl;
+	uint8_t nPoints;
+	void execute();
+};
+
+// PID: A fixed point PID controller. outPut = Kp * e + Ki * sum(e) - Kd * (processValue - previous processValue)
+// where e = setPoint - processValue. The derivative acts on the process value to avoid a kick on set point changes.
+// The gains are given as floating point numbers but converted to 8.8 fixed point when the component is created,
+// so they must be 0 ... 127.99 with a resolution of 1/256. No floating point is used while the ladder runs.
+// The controller is evaluated once every 'period' Timer1 cycles, Ki and Kd are per evaluation.
+// The evaluations are scheduled on the tick count: each one is due 'period' ticks after the previous one
+// was due, so a scan that starts late delays that evaluation only and the average period stays exact.
+// If a whole period is missed (a scan longer than the period), the schedule restarts from the late evaluation.
+// The output is limited to outMin...outMax and so is the integral term (anti-windup).
+// inPut is ENABLE: when '0' the output is set to outMin and the integral to outMin (its lower limit),
+// so on enabling the output starts from outMin. The first evaluation is made on the scan that enables.
+class PID: public Component {
+public:
+	PID(logicBit enable, numeric setPoint, numeric processValue, numeric outPut, float Kp, float Ki, float Kd, uint16_t period, uint16_t outMin, uint16_t outMax);
+private:
+	numeric spIndex, pvIndex;
+	int16_t kP, kI, kD;
+	uint16_t sampleTime;
+	uint16_t minOut, maxOut;
+	int32_t integral;
+	uint16_t prevPv;
+	uint32_t nextSample;
+	void execute();
+	uint16_t frameSize();
+	void saveFrame(uint8_t *frame);
+	void loadFrame(const uint8_t *frame);
+};
+
+// Ramp: Rate limiter. The output follows the input limited to minOut...maxOut, but moves at most
+// 'step' units every 'period' Timer1 cycles. Use it to soften set point changes or limit a PID output.
+// Uses 1 timer.
+class Ramp: public Component {
+public:
+	Ramp(numeric inPut, numeric outPut, uint16_t step, uint16_t period, uint16_t outMin, uint16_t outMax);
+private:
+	uint16_t maxStep;
+	uint16_t stepTime;
+	uint16_t minOut, maxOut;
+	uint8_t timerIndex;
+	void execute();
+};
+
+// PWMOut: Drives a hardware PWM pin with a duty cycle proportional to a numeric variable.
+// inPut = 0 gives 0% and inPut >= fullScale gives 100%.
+// Pins 9 and 10 are driven by Timer1 so their PWM frequency is 1 / TIMERTICK with 10 bit resolution.
+// Pins 5, 6 and 13 use the Arduino analogWrite() with 8 bit resolution. Do not use any other pins.
+class PWMOut: public Component {
+public:
+	PWMOut(numeric inPut, uint8_t pin, uint16_t fullScale);
+private:
+	uint16_t maxIn;
+	uint32_t mul;
+	uint16_t duty;
+	void execute();
+};
+
+// FunctionBlock: A reusable group of components (a subroutine) that is defined once and run for several instances.
+// The body works on a local window of the variable spaces: bit bytes bitWindow...bitWindow+bitBytes-1
+// and numerics intWindow...intWindow+intCount-1. The first window bits are parameters bound to global
+// bits per instance: bitIn inputs followed by bitOut outputs. Likewise the first window numerics are
+// intIn inputs followed by intOut outputs. The rest are local to each instance.
+// Usage: fb = new FunctionBlock(...); fb->define(); <new components of the body> fb->endDefine();
+// then fb->instance( bitBinding, intBinding ) for each instance, where the bindings are arrays
+// of bitIn + bitOut global bit numbers and intIn + intOut global numeric numbers, inputs first
+// (copied, so they can be temporary). instance() returns false if maxInstances or MAXTIMERS is exceeded.
+// Each instance has a frame holding its local bits, numerics, output parameters and component states.
+// The first instance runs on the timers of the body and every other one has a copy of them,
+// so MAXTIMERS must cover maxInstances * body timers.
+// On every scan the body is run for each instance in turn: the frame is copied into the window,
+// the inputs are copied in from their bindings, the body executes, the outputs are copied out to
+// their bindings and the frame is copied back. Inputs are never written, outputs never read.
+// Function blocks cannot be nested.
+class FunctionBlock: public Component {
+public:
+	FunctionBlock(uint8_t bitWindow, uint8_t bitBytes, uint8_t bitIn, uint8_t bitOut, numeric intWindow, uint8_t intCount, uint8_t intIn, uint8_t intOut, uint8_t maxInstances);
+	void define();
+	void endDefine();
+	bool instance(const logicBit *bitBinding, const numeric *intBinding);
+private:
+	uint8_t winBits, nBitBytes, nBitIn, nBitIO;
+	numeric winInts;
+	uint8_t nInts, nIntIn, nIntIO;
+	uint8_t firstTimer, nTimers;
+	uint8_t nBody;
+	Component **body;
+	uint8_t maxInst, nInst;
+	uint16_t frameBytes;
+	uint8_t *frames;
+	uint32_t timeBase;					// frameTime of the times in the frames
+	void execute();
+	void swapTimers(uint8_t base);
+	logicBit bitBinding(const uint8_t *frame, uint8_t param);
+	numeric intBinding(const uint8_t *frame, uint8_t param);
+	void load(const uint8_t *frame);
+	void store(uint8_t *frame);
+	uint16_t frameSize();
+	void saveFrame(uint8_t *frame);
+	void loadFrame(const uint8_t *frame);
+};
+
+// Sequencer: A sequential function chart (step/transition) engine.
+// Step n is active when bit firstStepBit + n is '1', so the step bits are the actions: use them as inputs
+// to the rest of the ladder. firstStepBit can be any bit, the step bits are looked at a byte at a time.
+// Transitions are added with transition( from, to, condition, time ): when step 'from' is active,
+// the condition bit is '1' and the step has been active for at least 'time' Timer1 cycles (32 bits, 0 = no wait),
+// step 'from' is deactivated and step 'to' activated. Timed steps use 1 timer each. transition() returns
+// the index of the transition, or NOSTEP if 'transitions' or MAXTIMERS would be exceeded.
+// branch( to2 ) makes the last transition also activate step to2 (parallel branches) and
+// join( from2 ) makes it also require and deactivate step from2 (end of parallel branches).
+// Only the transitions leaving the active steps are evaluated, and a step activated on this scan
+// is evaluated only on the next one. If two transitions leaving a step are true, the first one added wins.
+// inPut is RESET: when '1' all steps are cleared and the initial step activated. The initial step is also
+// activated at creation unless a step is already active (e.g. restored by RETENTIVE).
+class Sequencer: public Component {
+public:
+	Sequencer(logicBit reset, logicBit firstStepBit, uint8_t steps, uint8_t transitions, uint8_t initialStep);
+	uint8_t transition(uint8_t from, uint8_t to, logicBit condition, uint32_t time);
+	void branch(uint8_t to2);
+	void join(uint8_t from2);
+private:
+	struct SeqTransition {
+		uint8_t from, from2, to, to2;
+		uint8_t next;				// next transition leaving the same step
+		logicBit cond;
+		uint32_t time;
+	};
+	uint8_t nSteps, maxTrans, nTrans;
+	uint8_t initStep;
+	uint8_t *firstOut;				// first transition leaving each step
+	uint8_t *stepTimer;				// timer of each step, NOSTEP if the step is not timed
+	uint8_t *fire;					// transitions to fire on this scan, one bit each
+	SeqTransition *trans;
+	void activate(uint8_t step);
+	bool ready(uint8_t t);
+	void execute();
+};
+
 // ComponentList: Internal bookkeeping component to facilitate executing the ladder logic.
 // One instance is created automatically (named CList).
 // In Arduino setup() You MUST call CList.begin(); before creating any new Components
 // In Arduino loop() you execute the ladder logic by including the instruction CList.execute();
 // This will iterate through all declared components and execute each one once per loop()
+// If SCANBUDGET is defined, every scan is timed against the Timer1 tick. The counters below
+// tell how many scans overran the budget, how long the longest scan was (in ticks) and which
+// component (index in creation order) was executing when that scan ran out of budget
+// (NOBLOCK if the longest scan stayed within the budget).
+// run() is the same as execute() unless EVENT_SCAN is defined. Then it idles the processor until
+// EVENT_PIN changes or EVENT_TICKS timer ticks have passed and only then executes the scan.
+// If I2CLINK is defined, linkBegin() makes this PLC node number 'node' (0...LINK_NODES-1) and publishes
+// bits bitFirst...bitLast (by whole bytes) and numerics intFirst...intLast to all other nodes.
+// Published ranges of different nodes must not overlap. Received values are applied at the start of a scan.
+// linkAge() tells how many Timer1 cycles ago something was last received from a node (UINT32_MAX if never),
+// linkErrors() how many messages from that node were lost or rejected and linkTxErrors() how many
+// of our own messages failed. Failed messages are retried.
+// snapshot() copies the complete run time state (variables, timers and the state of every component)
+// into one contiguous blob of snapshotSize() bytes and restore() puts it back. A blob can be copied
+// with memcpy() to fork the ladder, but is only valid for the same ladder and configuration.
+// profile() is a debug help that times the ladder, see plc.cpp.
+// If RETENTIVE is defined, begin() restores the retained variables from EEPROM and execute()
+// checkpoints them back a byte at a time. retainWrites() tells how many EEPROM bytes have been written since begin().
 class ComponentList {
+	friend class FunctionBlock;
+	friend void listResources();
 public:
 	void begin();
 	bool add( Component *component );
 	void execute();
+	void run();
+	bool profile( uint16_t rounds, uint32_t limit );
+	uint16_t snapshotSize();
+	void snapshot( uint8_t *blob );
+	void restore( const uint8_t *blob );
+#ifdef I2CLINK
+	void linkBegin( uint8_t node, logicBit bitFirst, logicBit bitLast, numeric intFirst, numeric intLast );
+	uint32_t linkAge( uint8_t node );
+	uint16_t linkErrors( uint8_t node );
+	uint16_t linkTxErrors();
+#endif
+#ifdef RETENTIVE
+	uint32_t retainWrites();
+#endif
+#ifdef SCANBUDGET
+	uint16_t overruns();
+	uint32_t longestScan();
+	uint8_t longestScanBlock();
+	void clearScanStats();
+#ifdef FAILSAFE_OVERRUNS
+	bool failSafe();
+	void clearFailSafe();
+#endif
+#endif
 private:
 	uint8_t index;
 	Component *list[MAXCOMPONENTS];
@@ -280,5 +502,23 @@ private:
 
 extern ComponentList CList;
 
+#ifdef PLC_LADDER_FILE
+// PLC_BUILD: creates the components declared in PLC_LADDER (see plcladder.h). Call it in setup() after CList.begin().
+#define PLC_NEW(type, args) new type args;
+#define PLC_BUILD() do { PLC_LADDER(PLC_NEW) } while ( 0 )
+
+// plcRamBytes: RAM taken by the variables, timers, component list and the components of PLC_LADDER
+// (each 'new' costs 2 bytes of heap bookkeeping on top of the object). This is only the ladder's part:
+// not included are the extra components and what Sequencers and FunctionBlocks allocate for their
+// steps and instances, the I2CLINK shadow copy, and the library's own globals (scan monitor,
+// RETENTIVE image, I2CLINK buffers), all of which come on top.
+#define PLC_SIZEOF(type, args) + sizeof(type) + 2
+constexpr uint16_t plcRamBytes = BITSPACE + INTSPACE * sizeof(uint16_t) + MAXTIMERS * sizeof(uint32_t)
+	+ MAXCOMPONENTS * sizeof(Component *) PLC_LADDER(PLC_SIZEOF);
+#ifdef PLC_RAM_LIMIT
+static_assert( plcRamBytes <= PLC_RAM_LIMIT, "PLC_LADDER: the ladder needs more RAM than PLC_RAM_LIMIT" );
+#endif
+#endif
+
 #endif
 
@@ -23,6 +23,16 @@
 // Default is 1000000 i.e. 1 MHz 
 #define SPICLOCK 1000000
 
+// PLC_LADDER_FILE: Optionally declare the ladder in a header and let the compiler work out
+// BITSPACE, INTSPACE, MAXTIMERS and MAXCOMPONENTS from it (remove the comment to enable).
+// The sizes below are then ignored and components with invalid arguments fail to compile.
+// See plcladder.h for how to write the ladder header.
+//#define PLC_LADDER_FILE "ladder.h"
+#ifdef PLC_LADDER_FILE
+#include PLC_LADDER_FILE
+#include "plcladder.h"
+#endif
+
 // BITSPACE: memory space allocated for bit variables of the "ladder" logic
 // One bit of memory is allocated for each bit variable.
 // You can have bit variables numbered from 0 to (8 * BITSPACE)-1
@@ -31,37 +41,107 @@
 // are freely available for programming.
 // You may use OUTPUTS as inputs to logic elements, but you may NOT use
 // INPUTS as outputs.
+#ifndef PLC_LADDER_FILE
 #define BITSPACE 32
-
-#if BITSPACE <= 32
-typedef uint8_t logicBit;
-#else
-typedef uint16_t logicBit;
 #endif
 
+// (the size of a bit reference is picked by a template so that BITSPACE may be a constant expression)
+template<bool small> struct plcBitRef { typedef uint8_t type; };
+template<> struct plcBitRef<false> { typedef uint16_t type; };
+typedef plcBitRef<BITSPACE <= 32>::type logicBit;
+
 // INTSPACE: memory space allocated for numeric variables related to timing, counting etc
 // One uint16_t is allocated for each numeric. Be sure to check
 // the number of variables a logic component reserves. As a rule, the bit operations
 // do not reserve any numeric variables, neither do static timers or counters (where the timing or count is constant).
 // Variable timers and counters need 1 or more. A multiplexer uses 3 or 5
+#ifndef PLC_LADDER_FILE
 #define INTSPACE 16
+#endif
 typedef uint8_t numeric;
 
 // MAXTIMERS: The maximum number of timers reserved for the program
 // Make sure this number is equal or larger than the actual number of timers
 // used by all timing components together.
 // As a general rule, any delay or pulse will use 1 timer.
+#ifndef PLC_LADDER_FILE
 #define MAXTIMERS 8
+#endif
 
 // MAXCOMPONENTS: The maximum number of components allowed in the program
 // The list of components you create is maintained in a fixed size pointer array
 // to avoid dynamic allocation and to minimize the list iteration runtime.
 // Make sure this number is larger or equal to the actual number of all 
 // ladder components in your application (anything you create using 'new').
+#ifndef PLC_LADDER_FILE
 #define MAXCOMPONENTS 64
+#endif
 
 // INVERT_INPUTS: Optionally you can invert the sense of all inputs by defining this (just remove the comment)
 // All input '1's will turn to '0's and vice versa.
 #define INVERT_INPUTS
 
+// SCANBUDGET: Optionally monitor the duration of one ladder scan (CList.execute()) in TIMERTICKs
+// (remove the comment to enable). A scan that takes longer is counted as an overrun and the component
+// it was executing when the budget ran out is recorded. The monitor costs a store per component
+// and a little more work in the timer interrupt.
+// Note that the resolution is one tick, so a budget of 1 may already trip on a normal scan.
+//#define SCANBUDGET 20
+
+// FAILSAFE_OVERRUNS: Optionally, after this many consecutive overruns (or a single scan
+// that runs this many budgets without finishing) the outputs are forced to FAILSAFE_OUTPUTS
+// and the hardware watchdog is armed with timeout FAILSAFE_WDTO. From then on every scan must
+// complete within the watchdog timeout or the processor is reset. CList.clearFailSafe() releases the outputs.
+// FAILSAFE_OUTPUTS is the 16 bit image written to output bits 16...31 (bit 16 is the LSB).
+// Needs SCANBUDGET.
+//#define FAILSAFE_OVERRUNS 3
+#define FAILSAFE_OUTPUTS 0x0000
+#define FAILSAFE_WDTO WDTO_250MS
+
+// RETENTIVE: Optionally keep a range of bits and numerics over a power cycle (remove the comment to enable).
+// Bits RETAIN_BIT_FIRST...RETAIN_BIT_LAST and numerics RETAIN_INT_FIRST...RETAIN_INT_LAST are restored
+// from EEPROM in CList.begin(). Bits are retained by whole bytes, i.e. bits 32...39 go together.
+// A changed value is checkpointed at most once every RETAIN_INTERVAL TIMERTICKs, one byte per scan.
+// The checkpoints rotate over as many copies (RETAIN_SLOTS) as fit in the EEPROM (1024 bytes in the
+// Arduino Micro) from address RETAIN_EEPROM_BASE up. Each copy takes 2 + (retained bit bytes) +
+// 2 * (retained numerics) bytes. The build fails if the ranges are outside BITSPACE and INTSPACE.
+// A retained value that changes all the time gets each EEPROM byte written up to
+// 3600 / (RETAIN_INTERVAL in seconds * RETAIN_SLOTS) times an hour, and a byte lasts 100 000 writes.
+//#define RETENTIVE
+#define RETAIN_BIT_FIRST 32
+#define RETAIN_BIT_LAST 63
+#define RETAIN_INT_FIRST 8
+#define RETAIN_INT_LAST 15
+#define RETAIN_INTERVAL 10000
+#define RETAIN_EEPROM_BASE 0
+
+// EVENT_SCAN: Optionally scan on events instead of free running (remove the comment to enable).
+// A change on EVENT_PIN (must be an external interrupt pin: 0, 1, 2, 3 or 7 on the Arduino Micro)
+// starts a new scan as soon as the current one is finished, and the outputs are clocked out right
+// after the scan. Without events a scan is still made every EVENT_TICKS TIMERTICKs so that the
+// timers are serviced. Between scans the processor idles.
+// Use CList.run() instead of CList.execute() in loop() for this to have any effect.
+// If FAILSAFE_OVERRUNS is used, EVENT_TICKS must be well below the watchdog timeout.
+//#define EVENT_SCAN
+#define EVENT_PIN 7
+#define EVENT_TICKS 1
+
+// I2CLINK: Optionally exchange bits and numerics with other PLC nodes over the I2C connector
+// (remove the comment to enable). Each node publishes ranges of its own variables with
+// CList.linkBegin() and all other nodes receive them into the same variable numbers.
+// Only changed bytes are sent, at most LINK_FRAME of them per I2C message. In addition, every
+// LINK_REFRESH TIMERTICKs the next LINK_FRAME published bytes are resent in turn, changed or not.
+// This is the heartbeat and it makes good a message lost at one node.
+// LINK_NODES is the number of nodes on the bus, LINK_CLOCK the I2C clock rate. After each message
+// a node keeps quiet for LINK_NODES - 1 times as long as the message took, to leave the others their turn.
+// The link has its own TWI interrupt handler, so it cannot be used together with the Wire library.
+// Remember to close the 'I2C TERM' solder bridges on exactly one board.
+//#define I2CLINK
+#ifndef LINK_NODES
+#define LINK_NODES 4
+#endif
+#define LINK_FRAME 16
+#define LINK_REFRESH 20
+#define LINK_CLOCK 100000
+
 #endif /* LOGICCONFIG_H_ */
\ No newline at end of file
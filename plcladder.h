@@ -0,0 +1,202 @@
+/*
+ * plcladder.h
+ *
+ * Compile time sizing of the simple logic controller
+ * Included by plcconfig.h when PLC_LADDER_FILE is defined. Do not include it yourself.
+ *
+ * Instead of creating the components one by one with 'new' in setup(), declare the ladder
+ * in the header named by PLC_LADDER_FILE as a list of X( <component>, ( <arguments> ) ) entries:
+ *
+ *   #define PLC_LADDER(X) \
+ *       X( Astable,    ( 255, 16, 75, 425 ) ) \
+ *       X( Logic2,     ( 16, 0, 31, AND ) ) \
+ *       X( Monostable, ( 31, 18, 500 ) )
+ *
+ * and call PLC_BUILD(); in setup() right after CList.begin(). The compiler then
+ * - sizes BITSPACE, INTSPACE, MAXTIMERS and MAXCOMPONENTS exactly for the declared ladder
+ * - refuses to compile a component that writes to an input bit (0...15), reads a nonexistent
+ *   analog channel, drives a pin without PWM or has otherwise impossible arguments
+ * - computes plcRamBytes, the RAM taken by the ladder itself (see PLC_RAM_LIMIT below and plc.h
+ *   for what is not counted)
+ * Only the arguments that are bit or numeric numbers are looked at, the rest may be anything
+ * (floats, enums, PROGMEM tables) that is valid in setup().
+ *
+ * Sequencer and FunctionBlock need calls after they are created, so create them with 'new' as usual
+ * after PLC_BUILD() and reserve their resources with the PLC_EXTRA_... and PLC_MIN_... defines below.
+ * Define those in the ladder header if needed:
+ *   PLC_EXTRA_COMPONENTS	components created outside PLC_LADDER
+ *   PLC_EXTRA_TIMERS		timers used by them
+ *   PLC_MIN_BITSPACE		smallest BITSPACE to allocate (for bits used only by program code or extra components)
+ *   PLC_MIN_INTSPACE		smallest INTSPACE to allocate
+ *   PLC_RAM_LIMIT			fail the build if the ladder takes more RAM than this
+ * To see the sizes a ladder header gives without a board, run 'make -C host resources LADDER=<header>'
+ * (see host/resources.cpp); on the board listResources() prints them together with plcRamBytes.
+ */
+
+#ifndef PLCLADDER_H_
+#define PLCLADDER_H_
+
+#ifndef PLC_LADDER
+#error "PLC_LADDER_FILE must define PLC_LADDER(X)"
+#endif
+
+#ifndef PLC_EXTRA_COMPONENTS
+#define PLC_EXTRA_COMPONENTS 0
+#endif
+#ifndef PLC_EXTRA_TIMERS
+#define PLC_EXTRA_TIMERS 0
+#endif
+#ifndef PLC_MIN_BITSPACE
+#define PLC_MIN_BITSPACE 4
+#endif
+#ifndef PLC_MIN_INTSPACE
+#define PLC_MIN_INTSPACE 1
+#endif
+
+constexpr int16_t plcMax( int16_t a ) { return a; }
+template<typename... T> constexpr int16_t plcMax( int16_t a, T... rest ) {
+	return a > plcMax( rest... ) ? a : plcMax( rest... );
+}
+constexpr int16_t plcArrayMax( const int16_t *a, uint8_t n ) {
+	return n == 0 ? -1 : plcMax( a[n - 1], plcArrayMax( a, n - 1 ) );
+}
+constexpr uint16_t plcArraySum( const uint8_t *a, uint8_t n ) {
+	return n == 0 ? 0 : a[n - 1] + plcArraySum( a, n - 1 );
+}
+constexpr bool plcOutBit( int16_t bit ) { return bit >= 16; }
+constexpr bool plcPwmPin( int16_t pin ) { return pin == 5 || pin == 6 || pin == 9 || pin == 10 || pin == 13; }
+
+// Resource use of each component type, written in terms of its constructor arguments:
+// PLC_B_<type>: highest bit number used (-1 = none), PLC_I_<type>: highest numeric used (-1 = none),
+// PLC_T_<type>: timers used, PLC_V_<type>: true if the arguments are valid.
+// A new component type must be added here before it can be used in PLC_LADDER.
+#define PLC_B_Not(in, out)										plcMax( in, out )
+#define PLC_I_Not(in, out)										-1
+#define PLC_T_Not												0
+#define PLC_V_Not(in, out)										plcOutBit( out )
+
+#define PLC_B_Logic2(in1, in2, out, func)						plcMax( in1, in2, out )
+#define PLC_I_Logic2(in1, in2, out, func)						-1
+#define PLC_T_Logic2											0
+#define PLC_V_Logic2(in1, in2, out, func)						plcOutBit( out )
+
+#define PLC_B_Calc2(in1, in2, out, func)						-1
+#define PLC_I_Calc2(in1, in2, out, func)						plcMax( in1, in2, out )
+#define PLC_T_Calc2												0
+#define PLC_V_Calc2(in1, in2, out, func)						true
+
+#define PLC_B_Bistable(set, reset, out)							plcMax( set, reset, out )
+#define PLC_I_Bistable(set, reset, out)							-1
+#define PLC_T_Bistable											0
+#define PLC_V_Bistable(set, reset, out)							plcOutBit( out )
+
+#define PLC_B_Astable(in, out, t1, t2)							plcMax( in, out )
+#define PLC_I_Astable(in, out, t1, t2)							-1
+#define PLC_T_Astable											1
+#define PLC_V_Astable(in, out, t1, t2)							plcOutBit( out )
+
+#define PLC_B_Monostable(in, out, t)							plcMax( in, out )
+#define PLC_I_Monostable(in, out, t)							-1
+#define PLC_T_Monostable										1
+#define PLC_V_Monostable(in, out, t)							plcOutBit( out )
+
+#define PLC_B_VMonostable(in, out, t)							plcMax( in, out )
+#define PLC_I_VMonostable(in, out, t)							plcMax( t )
+#define PLC_T_VMonostable										1
+#define PLC_V_VMonostable(in, out, t)							plcOutBit( out )
+
+#define PLC_B_DnCounter(clock, reset, out, n)					plcMax( clock, reset, out )
+#define PLC_I_DnCounter(clock, reset, out, n)					-1
+#define PLC_T_DnCounter											0
+#define PLC_V_DnCounter(clock, reset, out, n)					plcOutBit( out )
+
+#define PLC_B_UpCounter(clock, reset, out)						plcMax( clock, reset )
+#define PLC_I_UpCounter(clock, reset, out)						plcMax( out )
+#define PLC_T_UpCounter											0
+#define PLC_V_UpCounter(clock, reset, out)						true
+
+#define PLC_B_Delay(in, reset, out, d, t)						plcMax( in, reset, out )
+#define PLC_I_Delay(in, reset, out, d, t)						-1
+#define PLC_T_Delay												1
+#define PLC_V_Delay(in, reset, out, d, t)						plcOutBit( out )
+
+#define PLC_B_VDelay(in, reset, out, d, t)						plcMax( in, reset, out )
+#define PLC_I_VDelay(in, reset, out, d, t)						plcMax( d, t )
+#define PLC_T_VDelay											1
+#define PLC_V_VDelay(in, reset, out, d, t)						plcOutBit( out )
+
+#define PLC_B_BitMux2_1(in1, in2, s0, out)						plcMax( in1, in2, s0, out )
+#define PLC_I_BitMux2_1(in1, in2, s0, out)						-1
+#define PLC_T_BitMux2_1											0
+#define PLC_V_BitMux2_1(in1, in2, s0, out)						plcOutBit( out )
+
+#define PLC_B_BitMux4_1(in1, in2, in3, in4, s0, s1, out)		plcMax( in1, in2, in3, in4, s0, s1, out )
+#define PLC_I_BitMux4_1(in1, in2, in3, in4, s0, s1, out)		-1
+#define PLC_T_BitMux4_1											0
+#define PLC_V_BitMux4_1(in1, in2, in3, in4, s0, s1, out)		plcOutBit( out )
+
+#define PLC_B_IntMux2_1(in1, in2, s0, out)						plcMax( s0 )
+#define PLC_I_IntMux2_1(in1, in2, s0, out)						plcMax( in1, in2, out )
+#define PLC_T_IntMux2_1											0
+#define PLC_V_IntMux2_1(in1, in2, s0, out)						true
+
+#define PLC_B_IntMux4_1(in1, in2, in3, in4, s0, s1, out)		plcMax( s0, s1 )
+#define PLC_I_IntMux4_1(in1, in2, in3, in4, s0, s1, out)		plcMax( in1, in2, in3, in4, out )
+#define PLC_T_IntMux4_1											0
+#define PLC_V_IntMux4_1(in1, in2, in3, in4, s0, s1, out)		true
+
+#define PLC_B_AnalogIn(channel, out, offset, mul)				-1
+#define PLC_I_AnalogIn(channel, out, offset, mul)				plcMax( out )
+#define PLC_T_AnalogIn											0
+#define PLC_V_AnalogIn(channel, out, offset, mul)				( channel >= 0 && channel <= 5 )
+
+#define PLC_B_CompareNumeric(in1, in2, out, cmp)				plcMax( out )
+#define PLC_I_CompareNumeric(in1, in2, out, cmp)				plcMax( in1, in2 )
+#define PLC_T_CompareNumeric									0
+#define PLC_V_CompareNumeric(in1, in2, out, cmp)				plcOutBit( out )
+
+#define PLC_B_Linearize(in, out, table, points)					-1
+#define PLC_I_Linearize(in, out, table, points)					plcMax( in, out )
+#define PLC_T_Linearize											0
+#define PLC_V_Linearize(in, out, table, points)					( points >= 2 )
+
+#define PLC_B_PID(en, sp, pv, out, kp, ki, kd, t, lo, hi)		plcMax( en )
+#define PLC_I_PID(en, sp, pv, out, kp, ki, kd, t, lo, hi)		plcMax( sp, pv, out )
+#define PLC_T_PID												0
+#define PLC_V_PID(en, sp, pv, out, kp, ki, kd, t, lo, hi)		( lo <= hi )
+
+#define PLC_B_Ramp(in, out, step, t, lo, hi)					-1
+#define PLC_I_Ramp(in, out, step, t, lo, hi)					plcMax( in, out )
+#define PLC_T_Ramp												1
+#define PLC_V_Ramp(in, out, step, t, lo, hi)					( lo <= hi )
+
+#define PLC_B_PWMOut(in, pin, fullScale)						-1
+#define PLC_I_PWMOut(in, pin, fullScale)						plcMax( in )
+#define PLC_T_PWMOut											0
+#define PLC_V_PWMOut(in, pin, fullScale)						( plcPwmPin( pin ) && fullScale > 0 )
+
+// X-macro helpers applied to every PLC_LADDER entry
+#define PLC_USE_BITS(type, args)	, PLC_B_##type args
+#define PLC_USE_INTS(type, args)	, PLC_I_##type args
+#define PLC_USE_TIMERS(type, args)	, PLC_T_##type
+#define PLC_CHECK(type, args)		static_assert( PLC_V_##type args, "PLC_LADDER: invalid arguments in " #type #args );
+
+constexpr int16_t plcBitUse[] = { -1 PLC_LADDER(PLC_USE_BITS) };
+constexpr int16_t plcIntUse[] = { -1 PLC_LADDER(PLC_USE_INTS) };
+constexpr uint8_t plcTimerUse[] = { PLC_EXTRA_TIMERS PLC_LADDER(PLC_USE_TIMERS) };
+PLC_LADDER(PLC_CHECK)
+
+constexpr uint16_t plcBitSpace = plcMax( PLC_MIN_BITSPACE, plcArrayMax( plcBitUse, sizeof(plcBitUse) / sizeof(plcBitUse[0]) ) / 8 + 1 );
+constexpr uint16_t plcIntSpace = plcMax( PLC_MIN_INTSPACE, plcArrayMax( plcIntUse, sizeof(plcIntUse) / sizeof(plcIntUse[0]) ) + 1 );
+constexpr uint16_t plcTimers = plcMax( 1, plcArraySum( plcTimerUse, sizeof(plcTimerUse) ) );
+constexpr uint16_t plcComponents = plcMax( 1, sizeof(plcTimerUse) - 1 + PLC_EXTRA_COMPONENTS );
+
+static_assert( plcIntSpace <= 256, "PLC_LADDER: numerics are numbered 0...255" );
+static_assert( plcTimers <= 255 && plcComponents <= 255, "PLC_LADDER: too many timers or components" );
+
+#define BITSPACE plcBitSpace
+#define INTSPACE plcIntSpace
+#define MAXTIMERS plcTimers
+#define MAXCOMPONENTS plcComponents
+
+#endif /* PLCLADDER_H_ */